@@ -0,0 +1,80 @@
+import fr.inria.caml.camljava.Callback;
+import fr.inria.caml.camljava.BoundCallback;
+import fr.inria.caml.camljava.Camlint;
+
+// Targets for jnibench.ml.  The methods do as little work as possible,
+// so that the measurements are dominated by the cost of the crossings.
+
+class Bench {
+    public static int sfield;
+    public int field;
+    public static Object sobj = new Object();
+
+    public static void sv() { }
+    public static int si(int x) { return x; }
+    public static long sl(long x) { return x; }
+    public static double sd(double x) { return x; }
+    public static Object so(Object x) { return x; }
+    public static Object snew() { return new Object(); }
+
+    public void v() { }
+    public int i(int x) { return x; }
+    public long l(long x) { return x; }
+    public double d(double x) { return x; }
+    public Object o(Object x) { return x; }
+
+    // Callbacks: perform n calls to the Caml object from a single
+    // Java method, so that the Caml->Java crossing is amortized.
+
+    private static final long _c0 = Callback.getCamlMethodID("c0");
+    private static final long _c1 = Callback.getCamlMethodID("c1");
+    private static final long _c3 = Callback.getCamlMethodID("c3");
+
+    public static int callbacksArray(Callback cb, int arity, int n)
+    {
+        int r = 0;
+        for (int i = 0; i < n; i++) {
+            switch (arity) {
+            case 0:
+                r += cb.callCamlint(_c0, new Object[] { }); break;
+            case 1:
+                r += cb.callCamlint(_c1, new Object[] { new Camlint(i) });
+                break;
+            default:
+                r += cb.callCamlint(_c3, new Object[] { new Camlint(i),
+                                                        new Camlint(1),
+                                                        new Camlint(2) });
+                break;
+            }
+        }
+        return r;
+    }
+
+    public static int callbacksTyped(Callback cb, int arity, int n)
+    {
+        int r = 0;
+        for (int i = 0; i < n; i++) {
+            switch (arity) {
+            case 0: r += cb.callCamlint0(_c0); break;
+            case 1: r += cb.callCamlint1(_c1, i); break;
+            default: r += cb.callCamlint3(_c3, i, 1, 2); break;
+            }
+        }
+        return r;
+    }
+
+    public static int callbacksBound(Callback cb, int arity, int n)
+    {
+        int r = 0;
+        BoundCallback b =
+            cb.bind(arity == 0 ? _c0 : arity == 1 ? _c1 : _c3);
+        for (int i = 0; i < n; i++) {
+            switch (arity) {
+            case 0: r += b.callCamlint0(); break;
+            case 1: r += b.callCamlint1(i); break;
+            default: r += b.callCamlint3(i, 1, 2); break;
+            }
+        }
+        return r;
+    }
+}
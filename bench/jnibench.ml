@@ -0,0 +1,292 @@
+(* Benchmarks for the OCaml-Java bridge.
+
+   Usage: jnibench [-quick] [-o <file>] [-only <prefix>]
+          jnibench -compare <baseline.json> <current.json> [-threshold <pct>]
+
+   Each benchmark measures the cost of one crossing (call, field access,
+   array element, conversion, callback...) and reports it in nanoseconds
+   per operation.  Results are written as JSON, one benchmark per line. *)
+
+open Jni
+
+(* Measurement *)
+
+let min_time = ref 0.2
+let only = ref ""
+let results = ref []
+
+let now = Unix.gettimeofday
+
+let time_run f n =
+  let t0 = now () in
+  f n;
+  now () -. t0
+
+(* [bench name ~ops f]: [f n] performs [n] iterations of [ops] operations
+   each.  The number of iterations is doubled until a run lasts at least
+   [!min_time]; the best of three runs is kept. *)
+
+let bench name ?(ops = 1) f =
+  let p = String.length !only in
+  if String.length name >= p && String.sub name 0 p = !only then begin
+    f 1;
+    let rec calibrate n =
+      let t = time_run f n in
+      if t >= !min_time || n >= 1 lsl 30 then n else calibrate (2 * n) in
+    let n = calibrate 16 in
+    let t = min (time_run f n) (min (time_run f n) (time_run f n)) in
+    let total = float n *. float ops in
+    let ns = t *. 1e9 /. total in
+    Printf.printf "%-40s %12.2f ns/op %14.0f ops/s\n%!"
+                  name ns (total /. t);
+    results := (name, ns, total /. t) :: !results
+  end
+
+let build =
+  match Sys.backend_type with
+  | Sys.Native -> "native"
+  | Sys.Bytecode -> "bytecode"
+  | Sys.Other s -> s
+
+let write_json file =
+  let oc = open_out file in
+  Printf.fprintf oc "{\"build\": \"%s\",\n \"ocaml\": \"%s\",\n \"results\": [\n"
+                 build Sys.ocaml_version;
+  let l = List.rev !results in
+  List.iteri
+    (fun i (name, ns, ops) ->
+       Printf.fprintf oc
+         "  {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f}%s\n"
+         name ns ops (if i = List.length l - 1 then "" else ","))
+    l;
+  output_string oc " ]}\n";
+  close_out oc
+
+(* Regression comparison.  Only reads the files written by [write_json]. *)
+
+let read_json file =
+  let ic = open_in file in
+  let res = Hashtbl.create 101 in
+  let order = ref [] in
+  begin try
+    while true do
+      let line = input_line ic in
+      try
+        Scanf.sscanf line " {\"name\": \"%s@\", \"ns_per_op\": %f"
+          (fun name ns ->
+             if not (Hashtbl.mem res name) then order := name :: !order;
+             Hashtbl.replace res name ns)
+      with Scanf.Scan_failure _ | End_of_file -> ()
+    done
+  with End_of_file -> close_in ic
+  end;
+  (res, List.rev !order)
+
+let compare_files threshold base cur =
+  let (b, _) = read_json base and (c, names) = read_json cur in
+  let regressions = ref 0 in
+  List.iter
+    (fun name ->
+       let ns = Hashtbl.find c name in
+       match Hashtbl.find_opt b name with
+       | None ->
+           Printf.printf "%-40s %12.2f ns/op (new)\n" name ns
+       | Some ns0 ->
+           let delta = (ns -. ns0) /. ns0 *. 100.0 in
+           let bad = delta > threshold in
+           if bad then incr regressions;
+           Printf.printf "%-40s %12.2f -> %12.2f ns/op %+7.1f%%%s\n"
+                         name ns0 ns delta (if bad then "  REGRESSION" else ""))
+    names;
+  if !regressions > 0 then begin
+    Printf.printf "%d regression(s) above %.1f%%\n" !regressions threshold;
+    exit 1
+  end
+
+(* The Caml object called back from Java *)
+
+class target = object
+  method c0 = 0
+  method c1 (x: int) = x
+  method c3 (x: int) (y: int) (z: int) = x + y + z
+end
+
+(* The benchmarks *)
+
+let benchmarks () =
+  let c = find_class "Bench" in
+  let init = get_methodID c "<init>" "()V" in
+  let o = alloc_object c in
+  call_nonvirtual_void_method o c init [||];
+  let sobj = get_static_object_field c (get_static_fieldID c "sobj" "Ljava/lang/Object;") in
+  let sm name sg = get_static_methodID c name sg
+  and vm name sg = get_methodID c name sg in
+  let sv = sm "sv" "()V" and si = sm "si" "(I)I" and sl = sm "sl" "(J)J"
+  and sd = sm "sd" "(D)D" and so = sm "so" "(Ljava/lang/Object;)Ljava/lang/Object;"
+  and v = vm "v" "()V" and i = vm "i" "(I)I" and l = vm "l" "(J)J"
+  and d = vm "d" "(D)D" and vo = vm "o" "(Ljava/lang/Object;)Ljava/lang/Object;" in
+
+  (* Static, virtual and nonvirtual calls, generic (argument array) *)
+  bench "call.static.void" (fun n ->
+    for _ = 1 to n do call_static_void_method c sv [||] done);
+  bench "call.static.int" (fun n ->
+    for k = 1 to n do ignore (call_static_camlint_method c si [|Camlint k|]) done);
+  bench "call.static.long" (fun n ->
+    for _ = 1 to n do ignore (call_static_long_method c sl [|Long 1L|]) done);
+  bench "call.static.double" (fun n ->
+    for _ = 1 to n do ignore (call_static_double_method c sd [|Double 1.0|]) done);
+  bench "call.static.object" (fun n ->
+    for _ = 1 to n do ignore (call_static_object_method c so [|Obj sobj|]) done);
+  bench "call.virtual.void" (fun n ->
+    for _ = 1 to n do call_void_method o v [||] done);
+  bench "call.virtual.int" (fun n ->
+    for k = 1 to n do ignore (call_camlint_method o i [|Camlint k|]) done);
+  bench "call.virtual.long" (fun n ->
+    for _ = 1 to n do ignore (call_long_method o l [|Long 1L|]) done);
+  bench "call.virtual.double" (fun n ->
+    for _ = 1 to n do ignore (call_double_method o d [|Double 1.0|]) done);
+  bench "call.virtual.object" (fun n ->
+    for _ = 1 to n do ignore (call_object_method o vo [|Obj sobj|]) done);
+  bench "call.nonvirtual.void" (fun n ->
+    for _ = 1 to n do call_nonvirtual_void_method o c v [||] done);
+  bench "call.nonvirtual.int" (fun n ->
+    for k = 1 to n do
+      ignore (call_nonvirtual_camlint_method o c i [|Camlint k|]) done);
+  bench "call.nonvirtual.long" (fun n ->
+    for _ = 1 to n do
+      ignore (call_nonvirtual_long_method o c l [|Long 1L|]) done);
+  bench "call.nonvirtual.double" (fun n ->
+    for _ = 1 to n do
+      ignore (call_nonvirtual_double_method o c d [|Double 1.0|]) done);
+  bench "call.nonvirtual.object" (fun n ->
+    for _ = 1 to n do
+      ignore (call_nonvirtual_object_method o c vo [|Obj sobj|]) done);
+
+  (* Same calls through the fixed-arity entry points *)
+  bench "call.fixed.static.void" (fun n ->
+    for _ = 1 to n do call_static_void_method_0 c sv done);
+  bench "call.fixed.static.int" (fun n ->
+    for k = 1 to n do ignore (call_static_camlint_method_1_int c si k) done);
+  bench "call.fixed.static.long" (fun n ->
+    for _ = 1 to n do ignore (call_static_long_method_1_long c sl 1L) done);
+  bench "call.fixed.static.double" (fun n ->
+    for _ = 1 to n do ignore (call_static_double_method_1_double c sd 1.0) done);
+  bench "call.fixed.static.object" (fun n ->
+    for _ = 1 to n do ignore (call_static_object_method_1_obj c so sobj) done);
+  bench "call.fixed.virtual.void" (fun n ->
+    for _ = 1 to n do call_void_method_0 o v done);
+  bench "call.fixed.virtual.int" (fun n ->
+    for k = 1 to n do ignore (call_camlint_method_1_int o i k) done);
+  bench "call.fixed.virtual.long" (fun n ->
+    for _ = 1 to n do ignore (call_long_method_1_long o l 1L) done);
+  bench "call.fixed.virtual.double" (fun n ->
+    for _ = 1 to n do ignore (call_double_method_1_double o d 1.0) done);
+  bench "call.fixed.virtual.object" (fun n ->
+    for _ = 1 to n do ignore (call_object_method_1_obj o vo sobj) done);
+
+  (* Field access *)
+  let f = get_fieldID c "field" "I" and sf = get_static_fieldID c "sfield" "I" in
+  bench "field.get.int" (fun n ->
+    for _ = 1 to n do ignore (get_int_field o f) done);
+  bench "field.set.int" (fun n ->
+    for _ = 1 to n do set_int_field o f 1l done);
+  bench "field.get.camlint" (fun n ->
+    for _ = 1 to n do ignore (get_camlint_field o f) done);
+  bench "field.set.camlint" (fun n ->
+    for k = 1 to n do set_camlint_field o f k done);
+  bench "field.get.static.int" (fun n ->
+    for _ = 1 to n do ignore (get_static_int_field c sf) done);
+  bench "field.set.static.int" (fun n ->
+    for _ = 1 to n do set_static_int_field c sf 1l done);
+
+  (* Arrays: element by element vs. region transfers *)
+  List.iter
+    (fun len ->
+       let ja = new_int_array len and buf = Array.make len 0 in
+       let da = new_double_array len and fbuf = Array.make len 0.0 in
+       bench (Printf.sprintf "array.int.element.%d" len) ~ops:len (fun n ->
+         for _ = 1 to n do
+           for k = 0 to len - 1 do buf.(k) <- get_camlint_array_element ja k done
+         done);
+       bench (Printf.sprintf "array.int.region.%d" len) ~ops:len (fun n ->
+         for _ = 1 to n do get_camlint_array_region ja 0 buf 0 len done);
+       bench (Printf.sprintf "array.double.element.%d" len) ~ops:len (fun n ->
+         for _ = 1 to n do
+           for k = 0 to len - 1 do fbuf.(k) <- get_double_array_element da k done
+         done);
+       bench (Printf.sprintf "array.double.region.%d" len) ~ops:len (fun n ->
+         for _ = 1 to n do get_double_array_region da 0 fbuf 0 len done))
+    [16; 1024];
+
+  (* Strings, by length *)
+  List.iter
+    (fun len ->
+       let s = String.make len 'a' in
+       let js = string_to_java s in
+       bench (Printf.sprintf "string.to_java.%d" len) (fun n ->
+         for _ = 1 to n do ignore (string_to_java s) done);
+       bench (Printf.sprintf "string.from_java.%d" len) (fun n ->
+         for _ = 1 to n do ignore (string_from_java js) done))
+    [0; 16; 256; 4096];
+  let s = String.concat "" (List.init 64 (fun _ -> "\xc3\xa9t\xc3\xa9")) in
+  let js = string_to_java s in
+  bench "string.to_java.nonascii.320" (fun n ->
+    for _ = 1 to n do ignore (string_to_java s) done);
+  bench "string.from_java.nonascii.320" (fun n ->
+    for _ = 1 to n do ignore (string_from_java js) done);
+
+  (* Callbacks, by arity.  Each run of [n] callbacks is a single Java call. *)
+  let cb = wrap_object (new target) in
+  let cbsig = "(Lfr/inria/caml/camljava/Callback;II)I" in
+  List.iter
+    (fun (kind, meth) ->
+       let m = sm meth cbsig in
+       List.iter
+         (fun arity ->
+            bench (Printf.sprintf "callback.%s.%d" kind arity) ~ops:1000
+              (fun n ->
+                 for _ = 1 to n do
+                   ignore (call_static_camlint_method c m
+                             [|Obj cb; Camlint arity; Camlint 1000|])
+                 done))
+         [0; 1; 3])
+    ["array", "callbacksArray"; "typed", "callbacksTyped";
+     "bound", "callbacksBound"];
+
+  (* Object handles: creation, and creation followed by finalization *)
+  let snew = sm "snew" "()Ljava/lang/Object;" in
+  bench "handle.create" ~ops:1000 (fun n ->
+    for _ = 1 to n do
+      for _ = 1 to 1000 do ignore (call_static_object_method_0 c snew) done;
+      Gc.minor ()
+    done);
+  bench "handle.create_finalize" ~ops:1000 (fun n ->
+    for _ = 1 to n do
+      for _ = 1 to 1000 do ignore (call_static_object_method_0 c snew) done;
+      Gc.full_major ()
+    done)
+
+let _ =
+  let output = ref "" and compare = ref [] and threshold = ref 10.0 in
+  Arg.parse
+    [ "-quick", Arg.Unit (fun () -> min_time := 0.02),
+        " Shorter runs (less accurate)";
+      "-o", Arg.Set_string output,
+        "<file> Write the results as JSON to <file>";
+      "-only", Arg.Set_string only,
+        "<prefix> Run only the benchmarks whose name starts with <prefix>";
+      "-compare", Arg.Unit (fun () -> compare := [""]),
+        "<base> <cur> Compare two result files, report regressions";
+      "-threshold", Arg.Set_float threshold,
+        "<pct> Slowdown reported as a regression (default 10)" ]
+    (fun f -> compare := f :: !compare)
+    "Usage: jnibench [options]";
+  match List.rev !compare with
+  | [] ->
+      benchmarks ();
+      if !output <> "" then write_json !output
+  | [""; base; cur] ->
+      compare_files !threshold base cur
+  | _ ->
+      prerr_endline "jnibench: -compare expects two result files";
+      exit 2
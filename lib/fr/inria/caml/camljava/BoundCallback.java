@@ -0,0 +1,334 @@
+package fr.inria.caml.camljava;
+
+// A method of a wrapped Caml object, resolved once by Callback.bind.
+// Invoking it does not look up the method again.
+
+public class BoundCallback {
+    BoundCallback(Callback cb, long b)
+    {
+        owner = cb;
+        bound = b;
+        Callback.cleaner.register(this, new Callback.Release((b << 2) | 1));
+    }
+
+    // Release the method closure now rather than when this object
+    // becomes unreachable.  Later calls throw IllegalStateException.
+    // The native structure is only freed by the Cleaner, since calls
+    // in progress in other threads may still use it.
+    public void release()
+    {
+        long b = bound;
+        owner = null;
+        bound = 0;
+        if (b != 0) Callback.release((b << 2) | 3);
+    }
+
+    public void callVoid(Object args[])
+    { Callback.callbackVoid(bound, 0, args); }
+
+    public boolean callBoolean(Object args[])
+    { return Callback.callbackBoolean(bound, 0, args); }
+
+    public byte callByte(Object args[])
+    { return Callback.callbackByte(bound, 0, args); }
+
+    public char callChar(Object args[])
+    { return Callback.callbackChar(bound, 0, args); }
+
+    public short callShort(Object args[])
+    { return Callback.callbackShort(bound, 0, args); }
+
+    public int callCamlint(Object args[])
+    { return Callback.callbackCamlint(bound, 0, args); }
+
+    public int callInt(Object args[])
+    { return Callback.callbackInt(bound, 0, args); }
+
+    public long callLong(Object args[])
+    { return Callback.callbackLong(bound, 0, args); }
+
+    public float callFloat(Object args[])
+    { return Callback.callbackFloat(bound, 0, args); }
+
+    public double callDouble(Object args[])
+    { return Callback.callbackDouble(bound, 0, args); }
+
+    public Object callObject(Object args[])
+    { return Callback.callbackObject(bound, 0, args); }
+
+    public void callVoid0()
+    { Callback.callbackVoid0(bound, 0); }
+
+    public void callVoid1(Object a)
+    { Callback.callbackVoid1(bound, 0, a); }
+
+    public void callVoid2(Object a, Object b)
+    { Callback.callbackVoid2(bound, 0, a, b); }
+
+    public void callVoid3(Object a, Object b, Object c)
+    { Callback.callbackVoid3(bound, 0, a, b, c); }
+
+    public void callVoid1(int a)
+    { Callback.callbackVoid1(bound, 0, a); }
+
+    public void callVoid2(int a, int b)
+    { Callback.callbackVoid2(bound, 0, a, b); }
+
+    public void callVoid3(int a, int b, int c)
+    { Callback.callbackVoid3(bound, 0, a, b, c); }
+
+    public void callVoid1(long a)
+    { Callback.callbackVoid1(bound, 0, a); }
+
+    public void callVoid2(long a, long b)
+    { Callback.callbackVoid2(bound, 0, a, b); }
+
+    public void callVoid3(long a, long b, long c)
+    { Callback.callbackVoid3(bound, 0, a, b, c); }
+
+    public void callVoid1(double a)
+    { Callback.callbackVoid1(bound, 0, a); }
+
+    public void callVoid2(double a, double b)
+    { Callback.callbackVoid2(bound, 0, a, b); }
+
+    public void callVoid3(double a, double b, double c)
+    { Callback.callbackVoid3(bound, 0, a, b, c); }
+
+    public boolean callBoolean0()
+    { return Callback.callbackBoolean0(bound, 0); }
+
+    public boolean callBoolean1(Object a)
+    { return Callback.callbackBoolean1(bound, 0, a); }
+
+    public boolean callBoolean2(Object a, Object b)
+    { return Callback.callbackBoolean2(bound, 0, a, b); }
+
+    public boolean callBoolean3(Object a, Object b, Object c)
+    { return Callback.callbackBoolean3(bound, 0, a, b, c); }
+
+    public boolean callBoolean1(int a)
+    { return Callback.callbackBoolean1(bound, 0, a); }
+
+    public boolean callBoolean2(int a, int b)
+    { return Callback.callbackBoolean2(bound, 0, a, b); }
+
+    public boolean callBoolean3(int a, int b, int c)
+    { return Callback.callbackBoolean3(bound, 0, a, b, c); }
+
+    public boolean callBoolean1(long a)
+    { return Callback.callbackBoolean1(bound, 0, a); }
+
+    public boolean callBoolean2(long a, long b)
+    { return Callback.callbackBoolean2(bound, 0, a, b); }
+
+    public boolean callBoolean3(long a, long b, long c)
+    { return Callback.callbackBoolean3(bound, 0, a, b, c); }
+
+    public boolean callBoolean1(double a)
+    { return Callback.callbackBoolean1(bound, 0, a); }
+
+    public boolean callBoolean2(double a, double b)
+    { return Callback.callbackBoolean2(bound, 0, a, b); }
+
+    public boolean callBoolean3(double a, double b, double c)
+    { return Callback.callbackBoolean3(bound, 0, a, b, c); }
+
+    public int callCamlint0()
+    { return Callback.callbackCamlint0(bound, 0); }
+
+    public int callCamlint1(Object a)
+    { return Callback.callbackCamlint1(bound, 0, a); }
+
+    public int callCamlint2(Object a, Object b)
+    { return Callback.callbackCamlint2(bound, 0, a, b); }
+
+    public int callCamlint3(Object a, Object b, Object c)
+    { return Callback.callbackCamlint3(bound, 0, a, b, c); }
+
+    public int callCamlint1(int a)
+    { return Callback.callbackCamlint1(bound, 0, a); }
+
+    public int callCamlint2(int a, int b)
+    { return Callback.callbackCamlint2(bound, 0, a, b); }
+
+    public int callCamlint3(int a, int b, int c)
+    { return Callback.callbackCamlint3(bound, 0, a, b, c); }
+
+    public int callCamlint1(long a)
+    { return Callback.callbackCamlint1(bound, 0, a); }
+
+    public int callCamlint2(long a, long b)
+    { return Callback.callbackCamlint2(bound, 0, a, b); }
+
+    public int callCamlint3(long a, long b, long c)
+    { return Callback.callbackCamlint3(bound, 0, a, b, c); }
+
+    public int callCamlint1(double a)
+    { return Callback.callbackCamlint1(bound, 0, a); }
+
+    public int callCamlint2(double a, double b)
+    { return Callback.callbackCamlint2(bound, 0, a, b); }
+
+    public int callCamlint3(double a, double b, double c)
+    { return Callback.callbackCamlint3(bound, 0, a, b, c); }
+
+    public int callInt0()
+    { return Callback.callbackInt0(bound, 0); }
+
+    public int callInt1(Object a)
+    { return Callback.callbackInt1(bound, 0, a); }
+
+    public int callInt2(Object a, Object b)
+    { return Callback.callbackInt2(bound, 0, a, b); }
+
+    public int callInt3(Object a, Object b, Object c)
+    { return Callback.callbackInt3(bound, 0, a, b, c); }
+
+    public int callInt1(int a)
+    { return Callback.callbackInt1(bound, 0, a); }
+
+    public int callInt2(int a, int b)
+    { return Callback.callbackInt2(bound, 0, a, b); }
+
+    public int callInt3(int a, int b, int c)
+    { return Callback.callbackInt3(bound, 0, a, b, c); }
+
+    public int callInt1(long a)
+    { return Callback.callbackInt1(bound, 0, a); }
+
+    public int callInt2(long a, long b)
+    { return Callback.callbackInt2(bound, 0, a, b); }
+
+    public int callInt3(long a, long b, long c)
+    { return Callback.callbackInt3(bound, 0, a, b, c); }
+
+    public int callInt1(double a)
+    { return Callback.callbackInt1(bound, 0, a); }
+
+    public int callInt2(double a, double b)
+    { return Callback.callbackInt2(bound, 0, a, b); }
+
+    public int callInt3(double a, double b, double c)
+    { return Callback.callbackInt3(bound, 0, a, b, c); }
+
+    public long callLong0()
+    { return Callback.callbackLong0(bound, 0); }
+
+    public long callLong1(Object a)
+    { return Callback.callbackLong1(bound, 0, a); }
+
+    public long callLong2(Object a, Object b)
+    { return Callback.callbackLong2(bound, 0, a, b); }
+
+    public long callLong3(Object a, Object b, Object c)
+    { return Callback.callbackLong3(bound, 0, a, b, c); }
+
+    public long callLong1(int a)
+    { return Callback.callbackLong1(bound, 0, a); }
+
+    public long callLong2(int a, int b)
+    { return Callback.callbackLong2(bound, 0, a, b); }
+
+    public long callLong3(int a, int b, int c)
+    { return Callback.callbackLong3(bound, 0, a, b, c); }
+
+    public long callLong1(long a)
+    { return Callback.callbackLong1(bound, 0, a); }
+
+    public long callLong2(long a, long b)
+    { return Callback.callbackLong2(bound, 0, a, b); }
+
+    public long callLong3(long a, long b, long c)
+    { return Callback.callbackLong3(bound, 0, a, b, c); }
+
+    public long callLong1(double a)
+    { return Callback.callbackLong1(bound, 0, a); }
+
+    public long callLong2(double a, double b)
+    { return Callback.callbackLong2(bound, 0, a, b); }
+
+    public long callLong3(double a, double b, double c)
+    { return Callback.callbackLong3(bound, 0, a, b, c); }
+
+    public double callDouble0()
+    { return Callback.callbackDouble0(bound, 0); }
+
+    public double callDouble1(Object a)
+    { return Callback.callbackDouble1(bound, 0, a); }
+
+    public double callDouble2(Object a, Object b)
+    { return Callback.callbackDouble2(bound, 0, a, b); }
+
+    public double callDouble3(Object a, Object b, Object c)
+    { return Callback.callbackDouble3(bound, 0, a, b, c); }
+
+    public double callDouble1(int a)
+    { return Callback.callbackDouble1(bound, 0, a); }
+
+    public double callDouble2(int a, int b)
+    { return Callback.callbackDouble2(bound, 0, a, b); }
+
+    public double callDouble3(int a, int b, int c)
+    { return Callback.callbackDouble3(bound, 0, a, b, c); }
+
+    public double callDouble1(long a)
+    { return Callback.callbackDouble1(bound, 0, a); }
+
+    public double callDouble2(long a, long b)
+    { return Callback.callbackDouble2(bound, 0, a, b); }
+
+    public double callDouble3(long a, long b, long c)
+    { return Callback.callbackDouble3(bound, 0, a, b, c); }
+
+    public double callDouble1(double a)
+    { return Callback.callbackDouble1(bound, 0, a); }
+
+    public double callDouble2(double a, double b)
+    { return Callback.callbackDouble2(bound, 0, a, b); }
+
+    public double callDouble3(double a, double b, double c)
+    { return Callback.callbackDouble3(bound, 0, a, b, c); }
+
+    public Object callObject0()
+    { return Callback.callbackObject0(bound, 0); }
+
+    public Object callObject1(Object a)
+    { return Callback.callbackObject1(bound, 0, a); }
+
+    public Object callObject2(Object a, Object b)
+    { return Callback.callbackObject2(bound, 0, a, b); }
+
+    public Object callObject3(Object a, Object b, Object c)
+    { return Callback.callbackObject3(bound, 0, a, b, c); }
+
+    public Object callObject1(int a)
+    { return Callback.callbackObject1(bound, 0, a); }
+
+    public Object callObject2(int a, int b)
+    { return Callback.callbackObject2(bound, 0, a, b); }
+
+    public Object callObject3(int a, int b, int c)
+    { return Callback.callbackObject3(bound, 0, a, b, c); }
+
+    public Object callObject1(long a)
+    { return Callback.callbackObject1(bound, 0, a); }
+
+    public Object callObject2(long a, long b)
+    { return Callback.callbackObject2(bound, 0, a, b); }
+
+    public Object callObject3(long a, long b, long c)
+    { return Callback.callbackObject3(bound, 0, a, b, c); }
+
+    public Object callObject1(double a)
+    { return Callback.callbackObject1(bound, 0, a); }
+
+    public Object callObject2(double a, double b)
+    { return Callback.callbackObject2(bound, 0, a, b); }
+
+    public Object callObject3(double a, double b, double c)
+    { return Callback.callbackObject3(bound, 0, a, b, c); }
+
+    private Callback owner;        // keeps the wrapped object alive
+    private volatile long bound;   // 0 once released
+}
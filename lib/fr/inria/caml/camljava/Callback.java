@@ -1,12 +1,54 @@
 package fr.inria.caml.camljava;
 
+import java.lang.ref.Cleaner;
+import java.util.concurrent.ConcurrentLinkedQueue;
+
 public class Callback {
-    public Callback(long obj) { objref = obj; }
+    public Callback(long obj)
+    {
+        objref = obj;
+        cleaner.register(this, new Release(obj << 1));
+    }
+
+    // Unreachable wrappers and bound callbacks are queued here, and
+    // released by the Caml side in batches (see drainReleased).
+    // Handles are (slot << 1) for a wrapper, (bound << 2) | 1 for an
+    // unreachable bound callback, and (bound << 2) | 3 for a bound
+    // callback released by BoundCallback.release(), which is only
+    // invalidated: it may still be in use by a call in progress.
+    static final Cleaner cleaner = Cleaner.create();
+    private static final ConcurrentLinkedQueue<Long> released =
+        new ConcurrentLinkedQueue<Long>();
+
+    static void release(long handle)
+    {
+        released.add(handle);
+        notifyReleased();
+    }
+
+    static class Release implements Runnable {
+        private final long handle;
+        Release(long h) { handle = h; }
+        public void run() { release(handle); }
+    }
 
-    protected void finalize() { freeWrapper(objref); }
+    static int drainReleased(long[] buf)
+    {
+        int n = 0;
+        Long h;
+        while (n < buf.length && (h = released.poll()) != null) buf[n++] = h;
+        return n;
+    }
 
     public native static long getCamlMethodID(String method_name);
 
+    // Resolve a method of the wrapped Caml object once and for all
+    public BoundCallback bind(long methid)
+    { return new BoundCallback(this, bindMethod(objref, methid)); }
+
+    public BoundCallback bind(String method_name)
+    { return bind(getCamlMethodID(method_name)); }
+
     public void callVoid(long methid, Object args[])
     { callbackVoid(objref, methid, args); }
 
@@ -40,28 +82,490 @@ public class Callback {
     public Object callObject(long methid, Object args[])
     { return callbackObject(objref, methid, args); }
 
+    // Typed callbacks: callXXXn passes its n arguments without wrapper
+    // objects.  Java int arguments are received as Caml int, long as
+    // int64, double as float.  (They are named apart from callXXX so
+    // that a single Object[] or null argument is never mistaken for
+    // an argument array.)
+
+    public void callVoid0(long methid)
+    { callbackVoid0(objref, methid); }
+
+    public void callVoid1(long methid, Object a)
+    { callbackVoid1(objref, methid, a); }
+
+    public void callVoid2(long methid, Object a, Object b)
+    { callbackVoid2(objref, methid, a, b); }
+
+    public void callVoid3(long methid, Object a, Object b, Object c)
+    { callbackVoid3(objref, methid, a, b, c); }
+
+    public void callVoid1(long methid, int a)
+    { callbackVoid1(objref, methid, a); }
+
+    public void callVoid2(long methid, int a, int b)
+    { callbackVoid2(objref, methid, a, b); }
+
+    public void callVoid3(long methid, int a, int b, int c)
+    { callbackVoid3(objref, methid, a, b, c); }
+
+    public void callVoid1(long methid, long a)
+    { callbackVoid1(objref, methid, a); }
+
+    public void callVoid2(long methid, long a, long b)
+    { callbackVoid2(objref, methid, a, b); }
+
+    public void callVoid3(long methid, long a, long b, long c)
+    { callbackVoid3(objref, methid, a, b, c); }
+
+    public void callVoid1(long methid, double a)
+    { callbackVoid1(objref, methid, a); }
+
+    public void callVoid2(long methid, double a, double b)
+    { callbackVoid2(objref, methid, a, b); }
+
+    public void callVoid3(long methid, double a, double b, double c)
+    { callbackVoid3(objref, methid, a, b, c); }
+
+    public boolean callBoolean0(long methid)
+    { return callbackBoolean0(objref, methid); }
+
+    public boolean callBoolean1(long methid, Object a)
+    { return callbackBoolean1(objref, methid, a); }
+
+    public boolean callBoolean2(long methid, Object a, Object b)
+    { return callbackBoolean2(objref, methid, a, b); }
+
+    public boolean callBoolean3(long methid, Object a, Object b, Object c)
+    { return callbackBoolean3(objref, methid, a, b, c); }
+
+    public boolean callBoolean1(long methid, int a)
+    { return callbackBoolean1(objref, methid, a); }
+
+    public boolean callBoolean2(long methid, int a, int b)
+    { return callbackBoolean2(objref, methid, a, b); }
+
+    public boolean callBoolean3(long methid, int a, int b, int c)
+    { return callbackBoolean3(objref, methid, a, b, c); }
+
+    public boolean callBoolean1(long methid, long a)
+    { return callbackBoolean1(objref, methid, a); }
+
+    public boolean callBoolean2(long methid, long a, long b)
+    { return callbackBoolean2(objref, methid, a, b); }
+
+    public boolean callBoolean3(long methid, long a, long b, long c)
+    { return callbackBoolean3(objref, methid, a, b, c); }
+
+    public boolean callBoolean1(long methid, double a)
+    { return callbackBoolean1(objref, methid, a); }
+
+    public boolean callBoolean2(long methid, double a, double b)
+    { return callbackBoolean2(objref, methid, a, b); }
+
+    public boolean callBoolean3(long methid, double a, double b, double c)
+    { return callbackBoolean3(objref, methid, a, b, c); }
+
+    public int callCamlint0(long methid)
+    { return callbackCamlint0(objref, methid); }
+
+    public int callCamlint1(long methid, Object a)
+    { return callbackCamlint1(objref, methid, a); }
+
+    public int callCamlint2(long methid, Object a, Object b)
+    { return callbackCamlint2(objref, methid, a, b); }
+
+    public int callCamlint3(long methid, Object a, Object b, Object c)
+    { return callbackCamlint3(objref, methid, a, b, c); }
+
+    public int callCamlint1(long methid, int a)
+    { return callbackCamlint1(objref, methid, a); }
+
+    public int callCamlint2(long methid, int a, int b)
+    { return callbackCamlint2(objref, methid, a, b); }
+
+    public int callCamlint3(long methid, int a, int b, int c)
+    { return callbackCamlint3(objref, methid, a, b, c); }
+
+    public int callCamlint1(long methid, long a)
+    { return callbackCamlint1(objref, methid, a); }
+
+    public int callCamlint2(long methid, long a, long b)
+    { return callbackCamlint2(objref, methid, a, b); }
+
+    public int callCamlint3(long methid, long a, long b, long c)
+    { return callbackCamlint3(objref, methid, a, b, c); }
+
+    public int callCamlint1(long methid, double a)
+    { return callbackCamlint1(objref, methid, a); }
+
+    public int callCamlint2(long methid, double a, double b)
+    { return callbackCamlint2(objref, methid, a, b); }
+
+    public int callCamlint3(long methid, double a, double b, double c)
+    { return callbackCamlint3(objref, methid, a, b, c); }
+
+    public int callInt0(long methid)
+    { return callbackInt0(objref, methid); }
+
+    public int callInt1(long methid, Object a)
+    { return callbackInt1(objref, methid, a); }
+
+    public int callInt2(long methid, Object a, Object b)
+    { return callbackInt2(objref, methid, a, b); }
+
+    public int callInt3(long methid, Object a, Object b, Object c)
+    { return callbackInt3(objref, methid, a, b, c); }
+
+    public int callInt1(long methid, int a)
+    { return callbackInt1(objref, methid, a); }
+
+    public int callInt2(long methid, int a, int b)
+    { return callbackInt2(objref, methid, a, b); }
+
+    public int callInt3(long methid, int a, int b, int c)
+    { return callbackInt3(objref, methid, a, b, c); }
+
+    public int callInt1(long methid, long a)
+    { return callbackInt1(objref, methid, a); }
+
+    public int callInt2(long methid, long a, long b)
+    { return callbackInt2(objref, methid, a, b); }
+
+    public int callInt3(long methid, long a, long b, long c)
+    { return callbackInt3(objref, methid, a, b, c); }
+
+    public int callInt1(long methid, double a)
+    { return callbackInt1(objref, methid, a); }
+
+    public int callInt2(long methid, double a, double b)
+    { return callbackInt2(objref, methid, a, b); }
+
+    public int callInt3(long methid, double a, double b, double c)
+    { return callbackInt3(objref, methid, a, b, c); }
+
+    public long callLong0(long methid)
+    { return callbackLong0(objref, methid); }
+
+    public long callLong1(long methid, Object a)
+    { return callbackLong1(objref, methid, a); }
+
+    public long callLong2(long methid, Object a, Object b)
+    { return callbackLong2(objref, methid, a, b); }
+
+    public long callLong3(long methid, Object a, Object b, Object c)
+    { return callbackLong3(objref, methid, a, b, c); }
+
+    public long callLong1(long methid, int a)
+    { return callbackLong1(objref, methid, a); }
+
+    public long callLong2(long methid, int a, int b)
+    { return callbackLong2(objref, methid, a, b); }
+
+    public long callLong3(long methid, int a, int b, int c)
+    { return callbackLong3(objref, methid, a, b, c); }
+
+    public long callLong1(long methid, long a)
+    { return callbackLong1(objref, methid, a); }
+
+    public long callLong2(long methid, long a, long b)
+    { return callbackLong2(objref, methid, a, b); }
+
+    public long callLong3(long methid, long a, long b, long c)
+    { return callbackLong3(objref, methid, a, b, c); }
+
+    public long callLong1(long methid, double a)
+    { return callbackLong1(objref, methid, a); }
+
+    public long callLong2(long methid, double a, double b)
+    { return callbackLong2(objref, methid, a, b); }
+
+    public long callLong3(long methid, double a, double b, double c)
+    { return callbackLong3(objref, methid, a, b, c); }
+
+    public double callDouble0(long methid)
+    { return callbackDouble0(objref, methid); }
+
+    public double callDouble1(long methid, Object a)
+    { return callbackDouble1(objref, methid, a); }
+
+    public double callDouble2(long methid, Object a, Object b)
+    { return callbackDouble2(objref, methid, a, b); }
+
+    public double callDouble3(long methid, Object a, Object b, Object c)
+    { return callbackDouble3(objref, methid, a, b, c); }
+
+    public double callDouble1(long methid, int a)
+    { return callbackDouble1(objref, methid, a); }
+
+    public double callDouble2(long methid, int a, int b)
+    { return callbackDouble2(objref, methid, a, b); }
+
+    public double callDouble3(long methid, int a, int b, int c)
+    { return callbackDouble3(objref, methid, a, b, c); }
+
+    public double callDouble1(long methid, long a)
+    { return callbackDouble1(objref, methid, a); }
+
+    public double callDouble2(long methid, long a, long b)
+    { return callbackDouble2(objref, methid, a, b); }
+
+    public double callDouble3(long methid, long a, long b, long c)
+    { return callbackDouble3(objref, methid, a, b, c); }
+
+    public double callDouble1(long methid, double a)
+    { return callbackDouble1(objref, methid, a); }
+
+    public double callDouble2(long methid, double a, double b)
+    { return callbackDouble2(objref, methid, a, b); }
+
+    public double callDouble3(long methid, double a, double b, double c)
+    { return callbackDouble3(objref, methid, a, b, c); }
+
+    public Object callObject0(long methid)
+    { return callbackObject0(objref, methid); }
+
+    public Object callObject1(long methid, Object a)
+    { return callbackObject1(objref, methid, a); }
+
+    public Object callObject2(long methid, Object a, Object b)
+    { return callbackObject2(objref, methid, a, b); }
+
+    public Object callObject3(long methid, Object a, Object b, Object c)
+    { return callbackObject3(objref, methid, a, b, c); }
+
+    public Object callObject1(long methid, int a)
+    { return callbackObject1(objref, methid, a); }
+
+    public Object callObject2(long methid, int a, int b)
+    { return callbackObject2(objref, methid, a, b); }
+
+    public Object callObject3(long methid, int a, int b, int c)
+    { return callbackObject3(objref, methid, a, b, c); }
+
+    public Object callObject1(long methid, long a)
+    { return callbackObject1(objref, methid, a); }
+
+    public Object callObject2(long methid, long a, long b)
+    { return callbackObject2(objref, methid, a, b); }
+
+    public Object callObject3(long methid, long a, long b, long c)
+    { return callbackObject3(objref, methid, a, b, c); }
+
+    public Object callObject1(long methid, double a)
+    { return callbackObject1(objref, methid, a); }
+
+    public Object callObject2(long methid, double a, double b)
+    { return callbackObject2(objref, methid, a, b); }
+
+    public Object callObject3(long methid, double a, double b, double c)
+    { return callbackObject3(objref, methid, a, b, c); }
+
     private long objref;
-    private native static
+    native static
         void callbackVoid(long obj, long methid, Object args[]);
-    private native static
+    native static
         boolean callbackBoolean(long obj, long methid, Object args[]);
-    private native static
+    native static
         byte callbackByte(long obj, long methid, Object args[]);
-    private native static
+    native static
         char callbackChar(long obj, long methid, Object args[]);
-    private native static
+    native static
         short callbackShort(long obj, long methid, Object args[]);
-    private native static
+    native static
         int callbackCamlint(long obj, long methid, Object args[]);
-    private native static
+    native static
         int callbackInt(long obj, long methid, Object args[]);
-    private native static
+    native static
         long callbackLong(long obj, long methid, Object args[]);
-    private native static
+    native static
         float callbackFloat(long obj, long methid, Object args[]);
-    private native static
+    native static
         double callbackDouble(long obj, long methid, Object args[]);
-    private native static
+    native static
         Object callbackObject(long obj, long methid, Object args[]);
-    private native static void freeWrapper(long obj);
+    native static
+        void callbackVoid0(long obj, long methid);
+    native static
+        void callbackVoid1(long obj, long methid, Object a);
+    native static
+        void callbackVoid2(long obj, long methid, Object a, Object b);
+    native static
+        void callbackVoid3(long obj, long methid, Object a, Object b, Object c);
+    native static
+        void callbackVoid1(long obj, long methid, int a);
+    native static
+        void callbackVoid2(long obj, long methid, int a, int b);
+    native static
+        void callbackVoid3(long obj, long methid, int a, int b, int c);
+    native static
+        void callbackVoid1(long obj, long methid, long a);
+    native static
+        void callbackVoid2(long obj, long methid, long a, long b);
+    native static
+        void callbackVoid3(long obj, long methid, long a, long b, long c);
+    native static
+        void callbackVoid1(long obj, long methid, double a);
+    native static
+        void callbackVoid2(long obj, long methid, double a, double b);
+    native static
+        void callbackVoid3(long obj, long methid, double a, double b, double c);
+    native static
+        boolean callbackBoolean0(long obj, long methid);
+    native static
+        boolean callbackBoolean1(long obj, long methid, Object a);
+    native static
+        boolean callbackBoolean2(long obj, long methid, Object a, Object b);
+    native static
+        boolean callbackBoolean3(long obj, long methid, Object a, Object b, Object c);
+    native static
+        boolean callbackBoolean1(long obj, long methid, int a);
+    native static
+        boolean callbackBoolean2(long obj, long methid, int a, int b);
+    native static
+        boolean callbackBoolean3(long obj, long methid, int a, int b, int c);
+    native static
+        boolean callbackBoolean1(long obj, long methid, long a);
+    native static
+        boolean callbackBoolean2(long obj, long methid, long a, long b);
+    native static
+        boolean callbackBoolean3(long obj, long methid, long a, long b, long c);
+    native static
+        boolean callbackBoolean1(long obj, long methid, double a);
+    native static
+        boolean callbackBoolean2(long obj, long methid, double a, double b);
+    native static
+        boolean callbackBoolean3(long obj, long methid, double a, double b, double c);
+    native static
+        int callbackCamlint0(long obj, long methid);
+    native static
+        int callbackCamlint1(long obj, long methid, Object a);
+    native static
+        int callbackCamlint2(long obj, long methid, Object a, Object b);
+    native static
+        int callbackCamlint3(long obj, long methid, Object a, Object b, Object c);
+    native static
+        int callbackCamlint1(long obj, long methid, int a);
+    native static
+        int callbackCamlint2(long obj, long methid, int a, int b);
+    native static
+        int callbackCamlint3(long obj, long methid, int a, int b, int c);
+    native static
+        int callbackCamlint1(long obj, long methid, long a);
+    native static
+        int callbackCamlint2(long obj, long methid, long a, long b);
+    native static
+        int callbackCamlint3(long obj, long methid, long a, long b, long c);
+    native static
+        int callbackCamlint1(long obj, long methid, double a);
+    native static
+        int callbackCamlint2(long obj, long methid, double a, double b);
+    native static
+        int callbackCamlint3(long obj, long methid, double a, double b, double c);
+    native static
+        int callbackInt0(long obj, long methid);
+    native static
+        int callbackInt1(long obj, long methid, Object a);
+    native static
+        int callbackInt2(long obj, long methid, Object a, Object b);
+    native static
+        int callbackInt3(long obj, long methid, Object a, Object b, Object c);
+    native static
+        int callbackInt1(long obj, long methid, int a);
+    native static
+        int callbackInt2(long obj, long methid, int a, int b);
+    native static
+        int callbackInt3(long obj, long methid, int a, int b, int c);
+    native static
+        int callbackInt1(long obj, long methid, long a);
+    native static
+        int callbackInt2(long obj, long methid, long a, long b);
+    native static
+        int callbackInt3(long obj, long methid, long a, long b, long c);
+    native static
+        int callbackInt1(long obj, long methid, double a);
+    native static
+        int callbackInt2(long obj, long methid, double a, double b);
+    native static
+        int callbackInt3(long obj, long methid, double a, double b, double c);
+    native static
+        long callbackLong0(long obj, long methid);
+    native static
+        long callbackLong1(long obj, long methid, Object a);
+    native static
+        long callbackLong2(long obj, long methid, Object a, Object b);
+    native static
+        long callbackLong3(long obj, long methid, Object a, Object b, Object c);
+    native static
+        long callbackLong1(long obj, long methid, int a);
+    native static
+        long callbackLong2(long obj, long methid, int a, int b);
+    native static
+        long callbackLong3(long obj, long methid, int a, int b, int c);
+    native static
+        long callbackLong1(long obj, long methid, long a);
+    native static
+        long callbackLong2(long obj, long methid, long a, long b);
+    native static
+        long callbackLong3(long obj, long methid, long a, long b, long c);
+    native static
+        long callbackLong1(long obj, long methid, double a);
+    native static
+        long callbackLong2(long obj, long methid, double a, double b);
+    native static
+        long callbackLong3(long obj, long methid, double a, double b, double c);
+    native static
+        double callbackDouble0(long obj, long methid);
+    native static
+        double callbackDouble1(long obj, long methid, Object a);
+    native static
+        double callbackDouble2(long obj, long methid, Object a, Object b);
+    native static
+        double callbackDouble3(long obj, long methid, Object a, Object b, Object c);
+    native static
+        double callbackDouble1(long obj, long methid, int a);
+    native static
+        double callbackDouble2(long obj, long methid, int a, int b);
+    native static
+        double callbackDouble3(long obj, long methid, int a, int b, int c);
+    native static
+        double callbackDouble1(long obj, long methid, long a);
+    native static
+        double callbackDouble2(long obj, long methid, long a, long b);
+    native static
+        double callbackDouble3(long obj, long methid, long a, long b, long c);
+    native static
+        double callbackDouble1(long obj, long methid, double a);
+    native static
+        double callbackDouble2(long obj, long methid, double a, double b);
+    native static
+        double callbackDouble3(long obj, long methid, double a, double b, double c);
+    native static
+        Object callbackObject0(long obj, long methid);
+    native static
+        Object callbackObject1(long obj, long methid, Object a);
+    native static
+        Object callbackObject2(long obj, long methid, Object a, Object b);
+    native static
+        Object callbackObject3(long obj, long methid, Object a, Object b, Object c);
+    native static
+        Object callbackObject1(long obj, long methid, int a);
+    native static
+        Object callbackObject2(long obj, long methid, int a, int b);
+    native static
+        Object callbackObject3(long obj, long methid, int a, int b, int c);
+    native static
+        Object callbackObject1(long obj, long methid, long a);
+    native static
+        Object callbackObject2(long obj, long methid, long a, long b);
+    native static
+        Object callbackObject3(long obj, long methid, long a, long b, long c);
+    native static
+        Object callbackObject1(long obj, long methid, double a);
+    native static
+        Object callbackObject2(long obj, long methid, double a, double b);
+    native static
+        Object callbackObject3(long obj, long methid, double a, double b, double c);
+    private native static long bindMethod(long obj, long methid);
+    private native static void notifyReleased();
 }
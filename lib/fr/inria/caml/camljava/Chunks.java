@@ -0,0 +1,109 @@
+package fr.inria.caml.camljava;
+
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.HashMap;
+import java.util.Iterator;
+import java.util.Map;
+
+// Used by Jni.Collections: elements of collections are moved to and
+// from Caml in chunks, one JNI call per chunk rather than several
+// per element.  The next* methods fill their array argument(s) with
+// the next elements of the iterator and return the number of elements
+// stored; less than the array length means the iterator is exhausted.
+
+public class Chunks {
+
+    static Iterator iterator(Object o)
+    {
+        if (o instanceof Iterator) return (Iterator) o;
+        if (o instanceof Map) return ((Map) o).entrySet().iterator();
+        return ((Iterable) o).iterator();
+    }
+
+    static int next(Iterator it, Object[] buf)
+    {
+        int n = 0;
+        while (n < buf.length && it.hasNext()) buf[n++] = it.next();
+        return n;
+    }
+
+    // Elements must be instances of java.lang.Number
+    static int nextInts(Iterator it, int[] buf)
+    {
+        int n = 0;
+        while (n < buf.length && it.hasNext())
+            buf[n++] = ((Number) it.next()).intValue();
+        return n;
+    }
+
+    static int nextLongs(Iterator it, long[] buf)
+    {
+        int n = 0;
+        while (n < buf.length && it.hasNext())
+            buf[n++] = ((Number) it.next()).longValue();
+        return n;
+    }
+
+    static int nextDoubles(Iterator it, double[] buf)
+    {
+        int n = 0;
+        while (n < buf.length && it.hasNext())
+            buf[n++] = ((Number) it.next()).doubleValue();
+        return n;
+    }
+
+    // [it] iterates over the entries of a map
+    static int nextEntries(Iterator it, Object[] keys, Object[] values)
+    {
+        int n = 0;
+        while (n < keys.length && it.hasNext()) {
+            Map.Entry e = (Map.Entry) it.next();
+            keys[n] = e.getKey();
+            values[n] = e.getValue();
+            n++;
+        }
+        return n;
+    }
+
+    // In the other direction, all the elements of the arrays are added.
+    // (Long and Double are those of java.lang, not of this package.)
+
+    static Object newArrayList(int capacity)
+    {
+        return new ArrayList(capacity);
+    }
+
+    static void add(Collection c, Object[] buf)
+    {
+        for (int i = 0; i < buf.length; i++) c.add(buf[i]);
+    }
+
+    static void addInts(Collection c, int[] buf)
+    {
+        for (int i = 0; i < buf.length; i++) c.add(Integer.valueOf(buf[i]));
+    }
+
+    static void addLongs(Collection c, long[] buf)
+    {
+        for (int i = 0; i < buf.length; i++)
+            c.add(java.lang.Long.valueOf(buf[i]));
+    }
+
+    static void addDoubles(Collection c, double[] buf)
+    {
+        for (int i = 0; i < buf.length; i++)
+            c.add(java.lang.Double.valueOf(buf[i]));
+    }
+
+    static Object newHashMap(int capacity)
+    {
+        return new HashMap(capacity);
+    }
+
+    static void putAll(Map m, Object[] keys, Object[] values)
+    {
+        for (int i = 0; i < keys.length; i++) m.put(keys[i], values[i]);
+    }
+
+}
@@ -6,4 +6,12 @@ public class Exception extends java.lang.Exception {
 
     public Exception (String msg) { super(msg); }
 
+    // Used by Jni.exception_stack_trace
+    static String stackTrace(Throwable t)
+    {
+        java.io.StringWriter w = new java.io.StringWriter();
+        t.printStackTrace(new java.io.PrintWriter(w));
+        return w.toString();
+    }
+
 }
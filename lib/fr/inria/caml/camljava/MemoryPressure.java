@@ -0,0 +1,40 @@
+package fr.inria.caml.camljava;
+
+import java.lang.management.ManagementFactory;
+import java.lang.management.MemoryNotificationInfo;
+import java.lang.management.MemoryPoolMXBean;
+import java.lang.management.MemoryType;
+import javax.management.Notification;
+import javax.management.NotificationEmitter;
+import javax.management.NotificationListener;
+
+public class MemoryPressure implements NotificationListener {
+
+    private static boolean installed = false;
+
+    public static synchronized void install(double threshold)
+    {
+        for (MemoryPoolMXBean pool : ManagementFactory.getMemoryPoolMXBeans()) {
+            if (pool.getType() != MemoryType.HEAP) continue;
+            if (! pool.isCollectionUsageThresholdSupported()) continue;
+            long max = pool.getUsage().getMax();
+            if (max <= 0) continue;
+            pool.setCollectionUsageThreshold((long) (max * threshold));
+        }
+        if (! installed) {
+            NotificationEmitter emitter =
+                (NotificationEmitter) ManagementFactory.getMemoryMXBean();
+            emitter.addNotificationListener(new MemoryPressure(), null, null);
+            installed = true;
+        }
+    }
+
+    public void handleNotification(Notification n, Object handback)
+    {
+        String type = n.getType();
+        if (type.equals(MemoryNotificationInfo.MEMORY_COLLECTION_THRESHOLD_EXCEEDED))
+            notifyPressure();
+    }
+
+    private native static void notifyPressure();
+}
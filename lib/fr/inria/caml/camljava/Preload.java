@@ -0,0 +1,22 @@
+package fr.inria.caml.camljava;
+
+// Loads the classes of camljava.jar and the classes named on the
+// command line, so that they are listed by -XX:DumpLoadedClassList
+// (see the appcds target in lib/Makefile).
+
+public class Preload {
+    static final String[] camljavaClasses = {
+        "Boolean", "BoundCallback", "Byte", "Callback", "Camlint", "Char",
+        "Chunks", "Double", "Exception", "Float", "Int", "Long",
+        "MemoryPressure", "Readclass", "Short"
+    };
+
+    public static void main(String[] args) throws ClassNotFoundException
+    {
+        ClassLoader loader = Preload.class.getClassLoader();
+        for (String c : camljavaClasses)
+            Class.forName("fr.inria.caml.camljava." + c, false, loader);
+        for (String c : args)
+            Class.forName(c, false, loader);
+    }
+}
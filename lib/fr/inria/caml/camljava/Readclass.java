@@ -1,12 +1,65 @@
 package fr.inria.caml.camljava;
 
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.Iterator;
+import java.util.List;
 import java.util.Vector;
 import java.io.*;
+import java.net.URI;
+import java.nio.file.FileSystem;
+import java.nio.file.FileSystems;
+import java.nio.file.Files;
+import java.nio.file.Path;
 import java.util.jar.*;
-import java.util.HashSet;
+import java.util.stream.Stream;
+
+// Reads class files from the class path, on behalf of camljavagen.
+// Commands are read from stdin, one per line:
+//   ?              answers 1
+//   R<class>       the class file of <class> (e.g. java/util/ArrayList)
+//   B<class> ...   the class files of several classes, separated by blanks
+//   P<package>     the class files of all classes of <package>
+//   Q              quit
+// Each class file is sent as 1, its length (4 bytes, big endian) and its
+// contents; a missing class as 0.  P sends a 0 after the last class.
+//
+// The class path is indexed once, on the first request.  Jar files are
+// kept open; classes of the Java platform (which are not in jar files
+// since Java 9) are indexed only if needed.
 
 public class Readclass {
 
+  // A class file, in a directory or in a jar file
+  private static class Source {
+    File file;
+    JarFile jar;
+    JarEntry entry;
+    Path path;
+    Source(File f) { file = f; }
+    Source(JarFile j, JarEntry e) { jar = j; entry = e; }
+    Source(Path p) { path = p; }
+    byte[] read() throws IOException
+    {
+      if (file != null) return readFile(file);
+      if (path != null) return Files.readAllBytes(path);
+      InputStream s = jar.getInputStream(entry);
+      try {
+        return readStream(s, entry.getSize());
+      } finally {
+        s.close();
+      }
+    }
+  }
+
+  // Class name -> class file; package name -> class names
+  private static HashMap classes = null;
+  private static HashMap packages = null;
+  private static boolean platformIndexed = false;
+
+  private static DataOutputStream out =
+    new DataOutputStream(new BufferedOutputStream(System.out));
+
   public static void main(String argv[])
   {
     Vector path = new Vector(10);
@@ -21,20 +74,27 @@ public class Readclass {
         if (cmdline.length() < 1) continue;
         switch (cmdline.charAt(0)) {
         case '?':
-          System.out.write(1);
+          out.write(1);
           break;
         case 'Q':
+          out.flush();
           return;
         case 'R':
-          readClass(path, cmdline.substring(1));
-          System.err.println("Done R");
+          if (classes == null) buildIndex(path);
+          readClass(cmdline.substring(1));
+          break;
+        case 'B':
+          if (classes == null) buildIndex(path);
+          String [] names = cmdline.substring(1).trim().split("\\s+");
+          for (int i = 0; i < names.length; i++)
+            if (names[i].length() > 0) readClass(names[i]);
           break;
         case 'P':
-          readPackage(path, cmdline.substring(1));
-          System.err.println("Done P");
+          if (classes == null) buildIndex(path);
+          readPackage(cmdline.substring(1));
           break;
         }
-        System.out.flush();
+        out.flush();
       } catch (IOException e) {
         /*nothing*/;
       }
@@ -55,90 +115,132 @@ public class Readclass {
       }
     }
   }
-  
+
   private static void addElementToPath(Vector pathvect, String element)
   {
     if (! pathvect.contains(element)) pathvect.add(element);
   }
-  
-  private static void readClass(Vector path, String classname)
+
+  // Index the class path.  As for the JVM, the first occurrence of a
+  // class in the class path wins.
+  private static void buildIndex(Vector path)
   {
-    for (int i = path.size() - 1; i >= 0; i--) {
+    classes = new HashMap();
+    packages = new HashMap();
+    for (int i = 0; i < path.size(); i++) {
       try {
         File pathcomp = new File((String) (path.elementAt(i)));
         if (!pathcomp.exists()) continue;
         if (pathcomp.isDirectory()) {
-          File f =
-            new File(pathcomp,
-                     classname.replace('/', File.separatorChar) + ".class");
-          if (! f.exists()) continue;
-          byte [] data = readFile(f);
-          System.out.write(1);
-          System.out.write(data);
-          return;
+          indexDirectory(pathcomp, "");
         }
         else if (pathcomp.isFile()) {
           JarFile jf = new JarFile(pathcomp);
-          JarEntry je = jf.getJarEntry(classname + ".class");
-          if (je == null) { jf.close(); continue; }
-          byte [] data = readStream(jf.getInputStream(je), je.getSize());
-          jf.close();
-          System.out.write(1);
-          System.out.write(data);
-          return;
+          boolean used = false;
+          for (java.util.Enumeration e = jf.entries(); e.hasMoreElements(); ) {
+            JarEntry je = (JarEntry) e.nextElement();
+            String entryname = je.getName();
+            if (! entryname.endsWith(".class")) continue;
+            used |= addClass(entryname, new Source(jf, je));
+          }
+          if (! used) jf.close();
         }
       } catch (IOException e) {
         /*nothing*/;
       }
     }
-    System.out.write(0);
   }
 
-  private static void readPackage(Vector path, String packagename)
+  private static void indexDirectory(File dir, String prefix)
+  {
+    String [] contents = dir.list();
+    if (contents == null) return;
+    for (int j = 0; j < contents.length; j++) {
+      File f = new File(dir, contents[j]);
+      if (f.isDirectory())
+        indexDirectory(f, prefix + contents[j] + "/");
+      else if (contents[j].endsWith(".class"))
+        addClass(prefix + contents[j], new Source(f));
+    }
+  }
+
+  // Index the classes of the Java platform, from the jrt: file system
+  private static void indexPlatform()
   {
-    HashSet classes = new HashSet();
-    for (int i = path.size() - 1; i >= 0; i--) {
+    platformIndexed = true;
+    try {
+      FileSystem fs = FileSystems.getFileSystem(URI.create("jrt:/"));
+      Stream s = Files.walk(fs.getPath("/modules"));
       try {
-        File pathcomp = new File((String) (path.elementAt(i)));
-        if (!pathcomp.exists()) continue;
-        if (pathcomp.isDirectory()) {
-          File d = new File(pathcomp,
-                            packagename.replace('/', File.separatorChar));
-          String [] contents = d.list();
-          if (contents == null) continue;
-          for (int j = 0; j < contents.length; j++) {
-            String f = contents[i];
-            if (! f.endsWith(".class")) continue;
-            if (! classes.add(packagename + '/' + f)) continue;
-            byte [] data = readFile(new File(d, f));
-            System.out.write(1);
-            System.out.write(data);
-          }
+        for (Iterator it = s.iterator(); it.hasNext(); ) {
+          Path p = (Path) it.next();
+          // /modules/<module>/<class file>
+          if (p.getNameCount() < 3 || ! p.toString().endsWith(".class"))
+            continue;
+          addClass(p.subpath(2, p.getNameCount()).toString(), new Source(p));
         }
-        else if (pathcomp.isFile()) {
-          JarInputStream js =
-            new JarInputStream(new FileInputStream(pathcomp));
-          JarEntry je;
-          while ((je = js.getNextJarEntry()) != null) {
-            String entryname = je.getName();
-            // System.err.println(entryname);
-            int lastslash = entryname.lastIndexOf('/');
-            if (lastslash == -1) continue;
-            if (! packagename.equals(entryname.substring(0, lastslash)))
-              continue;
-            if (! entryname.endsWith(".class")) continue;
-            if (! classes.add(entryname)) continue;
-            byte [] data = readStream(js, je.getSize());
-            System.out.write(1);
-            System.out.write(data);
-          }
-          js.close();
+      } finally {
+        s.close();
+      }
+    } catch (Exception e) {
+      /* Before Java 9: platform classes are in sun.boot.class.path */;
+    }
+  }
+
+  // [entryname] is e.g. java/util/ArrayList.class
+  private static boolean addClass(String entryname, Source src)
+  {
+    String classname = entryname.substring(0, entryname.length() - 6);
+    if (classes.containsKey(classname)) return false;
+    classes.put(classname, src);
+    int lastslash = classname.lastIndexOf('/');
+    String pkg = lastslash == -1 ? "" : classname.substring(0, lastslash);
+    List l = (List) packages.get(pkg);
+    if (l == null) { l = new ArrayList(); packages.put(pkg, l); }
+    l.add(classname);
+    return true;
+  }
+
+  private static void writeClass(Source src) throws IOException
+  {
+    byte [] data = src.read();
+    out.write(1);
+    out.writeInt(data.length);
+    out.write(data);
+  }
+
+  private static void readClass(String classname) throws IOException
+  {
+    Source src = (Source) classes.get(classname);
+    if (src == null && ! platformIndexed) {
+      indexPlatform();
+      src = (Source) classes.get(classname);
+    }
+    if (src == null) { out.write(0); return; }
+    try {
+      writeClass(src);
+    } catch (IOException e) {
+      out.write(0);
+    }
+  }
+
+  private static void readPackage(String packagename) throws IOException
+  {
+    List l = (List) packages.get(packagename);
+    if (l == null && ! platformIndexed) {
+      indexPlatform();
+      l = (List) packages.get(packagename);
+    }
+    if (l != null) {
+      for (int i = 0; i < l.size(); i++) {
+        try {
+          writeClass((Source) classes.get(l.get(i)));
+        } catch (IOException e) {
+          /*nothing*/;
         }
-      } catch (IOException e) {
-        /*nothing*/;
       }
     }
-    System.out.write(0);
+    out.write(0);
   }
 
   private static byte[] readFile(File f) throws IOException
@@ -151,13 +253,22 @@ public class Readclass {
     }
   }
 
+  // [length] is -1 if unknown: read until end of stream
   private static byte[] readStream(InputStream s, long length)
   throws IOException
   {
+    if (length < 0) {
+      ByteArrayOutputStream b = new ByteArrayOutputStream();
+      byte[] buffer = new byte[8192];
+      int nread;
+      while ((nread = s.read(buffer)) != -1) b.write(buffer, 0, nread);
+      return b.toByteArray();
+    }
     int len = (int) length;
     byte[] buffer = new byte[len];
     for (int i = 0; i < len; /*nothing*/) {
       int nread = s.read(buffer, i, len - i);
+      if (nread == -1) throw new EOFException();
       i += nread;
     }
     return buffer;
@@ -169,11 +280,8 @@ public class Readclass {
     while (true) {
       int i = s.read();
       if (i == -1) return null;
-      System.err.write(i);  System.err.flush();
       if (i == 10) return sb.toString();
       sb.append((char) i);
     }
   }
 }
-
-      
@@ -0,0 +1,78 @@
+(* Print the externals for fixed-arity method calls
+   (call_[static_]<type>_method_<n>[_<kind>]), implemented in
+   jnistubs.c by the FIXEDALL macros.  The Makefile runs this script
+   with "ocaml genfixed.ml" and substitutes its output for the line
+   %FIXED_ARITY_EXTERNALS% in jni.mlp and jni.mlip. *)
+
+(* Result types: name, C name, Caml type *)
+let results = [
+  "void", "Void", "unit";
+  "boolean", "Boolean", "bool";
+  "camlint", "Camlint", "(int [@untagged])";
+  "int", "Int", "(int32 [@unboxed])";
+  "long", "Long", "(int64 [@unboxed])";
+  "double", "Double", "(float [@unboxed])";
+  "object", "Object", "obj"
+]
+
+(* Argument kinds: name, C name, Caml type *)
+let kinds = [
+  "obj", "Obj", "obj";
+  "int", "Int", "(int [@untagged])";
+  "long", "Long", "(int64 [@unboxed])";
+  "double", "Double", "(float [@unboxed])"
+]
+
+let max_arity = 4
+
+let indent = String.make 17 ' '
+let width = 76
+
+(* Fill lines of at most [width] columns with [words] *)
+let wrap words =
+  let b = Buffer.create 256 in
+  let col = ref 0 in
+  List.iter
+    (fun w ->
+      if !col = 0 || !col + 1 + String.length w > width then begin
+        if !col > 0 then Buffer.add_char b '\n';
+        Buffer.add_string b indent;
+        col := String.length indent
+      end else begin
+        Buffer.add_char b ' ';
+        incr col
+      end;
+      Buffer.add_string b w;
+      col := !col + String.length w)
+    words;
+  Buffer.contents b
+
+let print_external static (res, cres, restyp) n kind =
+  let (suffix, csuffix, args) =
+    match kind with
+    | None -> ("", "", [])
+    | Some (k, ck, argtyp) -> ("_" ^ k, ck, List.init n (fun _ -> argtyp)) in
+  let name =
+    Printf.sprintf "call_%s%s_method_%d%s"
+      (if static then "static_" else "") res n suffix in
+  let prim =
+    Printf.sprintf "camljava_Call%s%sMethod%d%s"
+      (if static then "Static" else "") cres n csuffix in
+  let recv = if static then "clazz" else "obj" in
+  let words =
+    List.map (fun a -> a ^ " ->") (recv :: "methodID" :: args) @ [restyp] in
+  Printf.printf "external %s:\n%s\n        = \"%s_byte\"\n          \"%s\"\n"
+    name (wrap words) prim prim
+
+let () =
+  List.iteri
+    (fun i static ->
+      List.iteri
+        (fun j res ->
+          if i > 0 || j > 0 then print_newline ();
+          print_external static res 0 None;
+          for n = 1 to max_arity do
+            List.iter (fun k -> print_external static res n (Some k)) kinds
+          done)
+        results)
+    [false; true]
@@ -1,5 +1,16 @@
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#ifndef _MSC_VER
+#include <stdatomic.h>
+#endif
 #include <jni.h>
 #include <caml/mlvalues.h>
 #include <caml/memory.h>
@@ -7,24 +18,150 @@
 #include <caml/custom.h>
 #include <caml/fail.h>
 #include <caml/callback.h>
+#include <caml/signals.h>
+#include <caml/bigarray.h>
+#include <caml/version.h>
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
 
 static JavaVM * jvm;
-static JNIEnv * jenv;
 
 #define Val_jboolean(b) ((b) == JNI_FALSE ? Val_false : Val_true)
-#define Jboolean_val(v) (Val_bool(v) ? JNI_TRUE : JNI_FALSE)
+#define Jboolean_val(v) (Bool_val(v) ? JNI_TRUE : JNI_FALSE)
 
 /********** Threading *************/
 
-static JNIEnv * g_jenv;
+/* Each thread (systhread or domain) has its own JNI environment.
+   Threads that were not created by the JVM are attached to it the
+   first time they call a stub, and detached when they terminate. */
+
+static THREAD_LOCAL JNIEnv * thread_jenv;
+
+#ifdef _WIN32
+static DWORD detach_key;
+
+static void WINAPI detach_current_thread(void * env)
+{
+  if (env != NULL) (*jvm)->DetachCurrentThread(jvm);
+}
+
+static void init_threading(void)
+{
+  detach_key = FlsAlloc(detach_current_thread);
+}
+
+static void detach_at_exit(JNIEnv * env)
+{
+  FlsSetValue(detach_key, env);
+}
+#else
+static pthread_key_t detach_key;
+
+static void detach_current_thread(void * env)
+{
+  (*jvm)->DetachCurrentThread(jvm);
+}
+
+static void init_threading(void)
+{
+  pthread_key_create(&detach_key, detach_current_thread);
+}
+
+static void detach_at_exit(JNIEnv * env)
+{
+  pthread_setspecific(detach_key, env);
+}
+#endif
+
+static JNIEnv * attach_current_thread(void)
+{
+  JNIEnv * env;
 
-void init_threading() {
-  g_jenv = jenv;
+  if ((*jvm)->GetEnv(jvm, (void **) &env, JNI_VERSION_1_2) != JNI_OK) {
+    if ((*jvm)->AttachCurrentThread(jvm, (void **) &env, NULL) != JNI_OK)
+      caml_fatal_error("CamlJava: cannot attach thread to the Java VM");
+    detach_at_exit(env);
+  }
+  thread_jenv = env;
+  return env;
+}
+
+/* The JVM is started, or found already running, on first use: the
+   first stub that needs a JNI environment starts it with the default
+   class path and options recorded by [camljava_SetDefaultVMArgs].
+   No Caml code runs and nothing is allocated in the Caml heap on this
+   path, since the arguments of that stub are not registered as roots.
+   Threads and domains may race to start the JVM: start-up runs under
+   [jvm_start_lock], and [jvm_initialized] is set with release
+   semantics once the JVM and the class references are ready, so that
+   a thread that sees it set also sees them. */
+
+#ifdef _MSC_VER
+static volatile LONG jvm_initialized = 0;
+#define Jvm_initialized() InterlockedCompareExchange(&jvm_initialized, 0, 0)
+#define Set_jvm_initialized() InterlockedExchange(&jvm_initialized, 1)
+#else
+static _Atomic int jvm_initialized = 0;
+#define Jvm_initialized() \
+  atomic_load_explicit(&jvm_initialized, memory_order_acquire)
+#define Set_jvm_initialized() \
+  atomic_store_explicit(&jvm_initialized, 1, memory_order_release)
+#endif
+
+#ifdef _WIN32
+static SRWLOCK jvm_start_lock = SRWLOCK_INIT;
+#define Lock_jvm_start() AcquireSRWLockExclusive(&jvm_start_lock)
+#define Unlock_jvm_start() ReleaseSRWLockExclusive(&jvm_start_lock)
+#else
+static pthread_mutex_t jvm_start_lock = PTHREAD_MUTEX_INITIALIZER;
+#define Lock_jvm_start() pthread_mutex_lock(&jvm_start_lock)
+#define Unlock_jvm_start() pthread_mutex_unlock(&jvm_start_lock)
+#endif
+
+/* Set when the JVM was created by this code, rather than found running
+   (Caml code embedded in a Java program). */
+static int jvm_owned = 0;
+
+static char * default_classpath = NULL;
+static char ** default_options = NULL;
+static mlsize_t default_nopts = 0;
+
+static void init_jvm(const char * classpath,
+                     char * const * options, mlsize_t nopts);
+
+static void start_jvm(void)
+{
+  if (default_classpath == NULL) caml_failwith("Jni: not initialized");
+  init_jvm(default_classpath, default_options, default_nopts);
+}
+
+/* Number of critical sections open in this thread (see below).  No
+   JNI call is allowed while one is open. */
+static THREAD_LOCAL int critical_depth = 0;
+
+static JNIEnv * get_jenv(void)
+{
+  JNIEnv * env = thread_jenv;
+  if (critical_depth > 0)
+    caml_failwith("Jni: JNI call inside a critical section");
+  if (env != NULL) return env;
+  if (! Jvm_initialized()) {
+    start_jvm();
+    if (thread_jenv != NULL) return thread_jenv;
+  }
+  return attach_current_thread();
 }
 
-void camljava_check_main_thread() {
-  if(jenv != g_jenv) {
-    fprintf(stderr, "CamlJava: callbacks from threads other than main are not allowed: ABORT.\n");
+/* All stubs use the JNI environment of the calling thread */
+#define jenv (get_jenv())
+
+void camljava_check_caml_thread(JNIEnv * env) {
+  if (thread_jenv != env) {
+    fprintf(stderr, "CamlJava: callbacks from threads not running Caml code are not allowed: ABORT.\n");
     fflush(stderr);
     // raise a Java exception would be better
     exit(2);
@@ -32,44 +169,389 @@ void camljava_check_main_thread() {
   return;
 }
 
+/********** Critical sections *************/
+
+/* While a critical section on a Java array is open, the JNI forbids
+   calls to other JNI functions.  Stubs fail instead, in [get_jenv],
+   and global references released by the Caml GC in the meantime are
+   deleted when the critical section ends. */
+
+static THREAD_LOCAL struct deferred_ref {
+  jobject obj;
+  int weak;                     /* weak global reference? */
+} * deferred_refs = NULL;
+static THREAD_LOCAL int num_deferred_refs = 0, max_deferred_refs = 0;
+
+static void check_not_critical(void)
+{
+  if (critical_depth > 0)
+    caml_failwith("Jni: JNI call inside a critical section");
+}
+
+static void defer_delete_global_ref(jobject obj, int weak)
+{
+  struct deferred_ref * newrefs;
+
+  if (num_deferred_refs >= max_deferred_refs) {
+    max_deferred_refs = max_deferred_refs == 0 ? 64 : 2 * max_deferred_refs;
+    newrefs = realloc(deferred_refs,
+                      max_deferred_refs * sizeof(struct deferred_ref));
+    if (newrefs == NULL) return; /* leak rather than fail in a finalizer */
+    deferred_refs = newrefs;
+  }
+  deferred_refs[num_deferred_refs].obj = obj;
+  deferred_refs[num_deferred_refs].weak = weak;
+  num_deferred_refs++;
+}
+
+static void delete_deferred_refs(void)
+{
+  struct deferred_ref * r;
+  while (num_deferred_refs > 0) {
+    r = &deferred_refs[--num_deferred_refs];
+    if (r->weak)
+      (*jenv)->DeleteWeakGlobalRef(jenv, r->obj);
+    else
+      (*jenv)->DeleteGlobalRef(jenv, r->obj);
+  }
+  free(deferred_refs);
+  deferred_refs = NULL;
+  max_deferred_refs = 0;
+}
+
+/************ Statistics *************/
+
+/* Counters of crossings and conversions, for Jni.Stats.  They are only
+   updated while statistics are enabled.  The numbers of live global
+   references and of live root slots are always maintained, so that
+   they are exact whenever read.  Under OCaml 5, stubs and finalizers
+   run in parallel in several domains: counters are updated with
+   relaxed atomic additions.  A snapshot reads each counter atomically,
+   but not all of them at the same instant. */
+
+#ifdef _MSC_VER
+typedef volatile LONG64 counter;
+#define Counter_add(c,n) InterlockedExchangeAdd64(&(c), (n))
+#define Counter_get(c) InterlockedCompareExchange64(&(c), 0, 0)
+#define Counter_set(c,n) InterlockedExchange64(&(c), (n))
+#else
+typedef _Atomic int64_t counter;
+#define Counter_add(c,n) \
+  atomic_fetch_add_explicit(&(c), (n), memory_order_relaxed)
+#define Counter_get(c) atomic_load_explicit(&(c), memory_order_relaxed)
+#define Counter_set(c,n) atomic_store_explicit(&(c), (n), memory_order_relaxed)
+#endif
+
+enum {
+  STAT_VIRTUAL_CALLS, STAT_STATIC_CALLS, STAT_NONVIRTUAL_CALLS,
+  STAT_BATCH_CALLS, STAT_FIELD_ACCESSES, STAT_ARRAY_ELEMENT_ACCESSES,
+  STAT_ARRAY_REGION_TRANSFERS, STAT_STRING_CONVERSIONS, STAT_CALLBACKS,
+  STAT_EXCEPTIONS_RAISED, STAT_EXCEPTIONS_THROWN,
+  STAT_STRING_BYTES, STAT_ARRAY_BYTES, STAT_JAVA_TIME,
+  NUM_STATS
+};
+
+static counter stats_enabled = 0;
+static counter stats[NUM_STATS];
+static counter live_global_refs = 0;
+static counter live_root_slots = 0;
+
+#define Stat_incr(c) Stat_add(c, 1)
+#define Stat_add(c,n) \
+  (Counter_get(stats_enabled) ? (void) Counter_add(stats[c], (n)) : (void) 0)
+#define Stat_region(nbytes) \
+  (Stat_incr(STAT_ARRAY_REGION_TRANSFERS), Stat_add(STAT_ARRAY_BYTES, nbytes))
+
+/* Monotonic clock, in nanoseconds */
+static uint64_t stats_clock(void)
+{
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+  if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (uint64_t) ((double) now.QuadPart * 1e9 / (double) freq.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* Execute [code], adding its duration to the time spent in Java */
+#define TIMED(code)                                                         \
+  if (Counter_get(stats_enabled)) {                                         \
+    uint64_t stats_t0 = stats_clock();                                      \
+    code;                                                                   \
+    Counter_add(stats[STAT_JAVA_TIME], stats_clock() - stats_t0);           \
+  } else {                                                                  \
+    code;                                                                   \
+  }
+
+value camljava_StatsEnable(value vflag)
+{
+  Counter_set(stats_enabled, Bool_val(vflag));
+  return Val_unit;
+}
+
+value camljava_StatsEnabled(value unit)
+{
+  return Val_bool(Counter_get(stats_enabled));
+}
+
+value camljava_StatsReset(value unit)
+{
+  int i;
+  for (i = 0; i < NUM_STATS; i++) Counter_set(stats[i], 0);
+  return Val_unit;
+}
+
+value camljava_StatsSnapshot(value unit)
+{
+  value res, t;
+  int i;
+
+  t = caml_copy_double((double) Counter_get(stats[STAT_JAVA_TIME]) * 1e-9);
+  Begin_root(t);
+    res = caml_alloc(NUM_STATS + 2, 0);
+    for (i = 0; i < NUM_STATS; i++)
+      if (i != STAT_JAVA_TIME)
+        Field(res, i) = Val_long(Counter_get(stats[i]));
+    Field(res, STAT_JAVA_TIME) = t;
+    Field(res, NUM_STATS) = Val_long(Counter_get(live_global_refs));
+    Field(res, NUM_STATS + 1) = Val_long(Counter_get(live_root_slots));
+  End_roots();
+  return res;
+}
+
 /************ Wrapping of Java objects as Caml values *************/
 
-#define JObject(v) (*((jobject *) Data_custom_val(v)))
+/* A handle holds the identity hash code of its object, computed by
+   [System.identityHashCode] when the handle is allocated.  Hashing
+   and comparison of handles follow Java identity ([==]), not
+   [equals()]: two handles on the same object are equal, whatever the
+   kind of reference. */
+
+struct jobject_handle {
+  jobject obj;
+  jint hash;
+  int64_t frame;                /* frame of a local reference, else 0 */
+};
+
+#define Handle_val(v) ((struct jobject_handle *) Data_custom_val(v))
+
+/* Local frames (see [camljava_PushLocalFrame]) are numbered in the
+   order they are pushed, across all threads.  [live_frames] lists the
+   frames of the current thread that are not popped yet, innermost
+   last.  A local reference whose frame is no longer live is dangling:
+   using it raises [Invalid_argument] instead of crashing the JVM. */
+
+static THREAD_LOCAL int64_t * live_frames = NULL;
+static THREAD_LOCAL int num_live_frames = 0, max_live_frames = 0;
+static counter last_frame = 0;
+
+static struct custom_operations jobject_local_ops;
+
+static int frame_is_live(int64_t frame)
+{
+  int i;
+  for (i = num_live_frames - 1; i >= 0 && live_frames[i] >= frame; i--)
+    if (live_frames[i] == frame) return 1;
+  return 0;
+}
+
+static value check_handle(value v)
+{
+  if (Custom_ops_val(v) == &jobject_local_ops
+      && ! frame_is_live(Handle_val(v)->frame))
+    caml_invalid_argument("Jni: local reference used outside its frame");
+  return v;
+}
+
+#define JObject(v) (Handle_val(check_handle(v))->obj)
+
+static void init_handle(value v, jobject obj, jint hash)
+{
+  Handle_val(v)->obj = obj;
+  Handle_val(v)->hash = hash;
+  Handle_val(v)->frame = 0;
+}
+
+/* Set once by [init_class_refs] */
+static jclass system_class = NULL;
+static jmethodID identity_hash_code = NULL;
+
+/* Called before allocating a handle, never inside critical sections */
+static jint identity_hash(jobject obj)
+{
+  if (obj == NULL) return 0;
+  return (*jenv)->CallStaticIntMethod(jenv, system_class,
+                                      identity_hash_code, obj);
+}
+
+/* Used by the custom hash function, which is called from [caml_hash]
+   (a [@@noalloc] primitive): it must not call the JVM nor raise,
+   even on a dangling local reference. */
+#define Handle_hash(v) (Handle_val(v)->hash)
+
+static intnat hash_jobject(value v)
+{
+  return Handle_hash(v);
+}
+
+/* Objects are ordered by identity hash code.  Distinct objects with
+   the same hash code (rare) are ordered by reference, which is not
+   stable across handles: use hash tables rather than ordered maps for
+   collections of Java objects. */
+
+static int compare_jobject(value v1, value v2)
+{
+  jint h1, h2;
+  jobject o1 = JObject(v1), o2 = JObject(v2);
+
+  if (o1 == o2) return 0;
+  if ((*jenv)->IsSameObject(jenv, o1, o2)) return 0;
+  h1 = Handle_hash(v1);
+  h2 = Handle_hash(v2);
+  if (h1 != h2) return h1 < h2 ? -1 : 1;
+  if (o1 == NULL) return -1;
+  if (o2 == NULL) return 1;
+  return o1 < o2 ? -1 : 1;
+}
 
 static void finalize_jobject(value v)
 {
   jobject obj = JObject(v);
-  if (obj != NULL) (*jenv)->DeleteGlobalRef(jenv, obj);
+  if (obj == NULL) return;
+  Counter_add(live_global_refs, -1);
+  if (critical_depth > 0)
+    defer_delete_global_ref(obj, 0);
+  else
+    (*jenv)->DeleteGlobalRef(jenv, obj);
 }
 
 static struct custom_operations jobject_ops = {
   "java.lang.Object",
   finalize_jobject,
-  custom_compare_default,       /* TODO? call equals() or compareTo() */
-  custom_hash_default,          /* TODO? call hashCode() */
+  compare_jobject,
+  hash_jobject,
   custom_serialize_default,     /* TODO? use Java serialization intf */
   custom_deserialize_default    /* TODO? use Java serialization intf */
 };
 
-static value caml_alloc_jobject(jobject obj)
+/* Inside a local frame (see [camljava_PushLocalFrame]), objects are
+   represented by JNI local references, which are freed when the frame
+   is popped and need no finalization.  Their handles record the frame
+   (see [check_handle]). */
+
+static THREAD_LOCAL int local_frame_depth = 0;
+
+static struct custom_operations jobject_local_ops = {
+  "java.lang.Object/local",
+  custom_finalize_default,
+  compare_jobject,
+  hash_jobject,
+  custom_serialize_default,
+  custom_deserialize_default
+};
+
+/* The Caml GC is told how much Java memory each global reference keeps
+   alive, so that handles on large objects are finalized early enough.
+   Arrays created from Caml report their actual size; other objects
+   report [object_size_hint] bytes. */
+
+static mlsize_t object_size_hint = 64;
+
+value camljava_SetObjectSizeHint(value vsize)
+{
+  object_size_hint = Long_val(vsize);
+  return Val_unit;
+}
+
+/* Set by the JVM (see MemoryPressure.java) when the Java heap is
+   nearly full after a collection.  The next handle allocation then
+   declares itself as large as the whole major heap, which makes the
+   Caml GC schedule a major slice and finalize unreachable handles
+   sooner.  (No Caml code is run from here: the callers' arguments
+   are not registered as roots.) */
+
+static volatile int heap_pressure = 0;
+
+void camljava_NotifyPressure(JNIEnv * env, jclass cls)
 {
-  value v = caml_alloc_custom(&jobject_ops, sizeof(jobject), 0, 1);
+  heap_pressure = 1;
+}
+
+static value alloc_global_jobject(jobject obj, mlsize_t mem)
+{
+  value v;
+  jint hash;
+  check_not_critical();
+  hash = identity_hash(obj);
+  if (heap_pressure && obj != NULL) {
+    heap_pressure = 0;
+    v = caml_alloc_custom(&jobject_ops, sizeof(struct jobject_handle), 1, 1);
+  } else {
+    v = caml_alloc_custom_mem(&jobject_ops, sizeof(struct jobject_handle),
+                              obj == NULL ? 0 : mem);
+  }
+  init_handle(v, NULL, 0);
   if (obj != NULL) {
     obj = (*jenv)->NewGlobalRef(jenv, obj);
     if (obj == NULL) caml_raise_out_of_memory();
+    Counter_add(live_global_refs, 1);
   }
-  JObject(v) = obj;
+  init_handle(v, obj, hash);
   return v;
 }
 
+static value caml_alloc_jobject_global(jobject obj)
+{
+  return alloc_global_jobject(obj, object_size_hint);
+}
+
+static value caml_alloc_jobject_sized(jobject obj, mlsize_t mem)
+{
+  value v;
+  jint hash;
+  if (local_frame_depth == 0 || obj == NULL)
+    return alloc_global_jobject(obj, mem);
+  check_not_critical();
+  hash = identity_hash(obj);
+  v = caml_alloc_custom(&jobject_local_ops, sizeof(struct jobject_handle),
+                        0, 1);
+  init_handle(v, obj, hash);
+  Handle_val(v)->frame = live_frames[num_live_frames - 1];
+  return v;
+}
+
+static value caml_alloc_jobject(jobject obj)
+{
+  return caml_alloc_jobject_sized(obj, object_size_hint);
+}
+
+/* Object results of methods and fields whose declared type is an
+   array report the actual size of the array.  [eltsize] is the size
+   of the array elements, 0 if the type is not an array type. */
+
+static value alloc_result(jobject obj, int eltsize)
+{
+  mlsize_t mem = object_size_hint;
+  if (eltsize > 0 && obj != NULL)
+    mem = (mlsize_t) (*jenv)->GetArrayLength(jenv, obj) * eltsize + 16;
+  return caml_alloc_jobject_sized(obj, mem);
+}
+
 value camljava_GetNull(value unit)
 {
   return caml_alloc_jobject(NULL);
 }
 
+/* [@@noalloc]: must not raise, hence no [check_handle].  A local
+   reference outside its frame is still distinguished from [null]. */
 value camljava_IsNull(value vobj)
 {
-  return Val_bool(JObject(vobj) == NULL);
+  return Val_bool(Handle_val(vobj)->obj == NULL);
 }
 
 /*********** Reflecting Java exceptions as Caml exceptions *************/
@@ -81,34 +563,85 @@ value camljava_set_debug(value v) {
   return Val_unit;
 }
 
+/* Optionally, instances of common Java exception classes are mapped to
+   distinct Caml exceptions.  Subclasses come before their superclasses.
+   The classes are looked up once by [init_class_refs]. */
+
+static int exception_mapping = 0;
+
+static struct {
+  const char * class_name;
+  const char * caml_name;
+  jclass cls;
+} mapped_exceptions[] = {
+  { "java/lang/NumberFormatException", "camljava_number_format", NULL },
+  { "java/lang/IllegalArgumentException", "camljava_illegal_argument", NULL },
+  { "java/lang/IllegalStateException", "camljava_illegal_state", NULL },
+  { "java/lang/IndexOutOfBoundsException", "camljava_index_out_of_bounds", NULL },
+  { "java/lang/ClassCastException", "camljava_class_cast", NULL },
+  { "java/lang/ArithmeticException", "camljava_arithmetic", NULL },
+  { "java/lang/UnsupportedOperationException", "camljava_unsupported_operation", NULL },
+  { "java/lang/NullPointerException", "camljava_null_pointer_exception", NULL },
+  { "java/io/IOException", "camljava_io_exception", NULL }
+};
+
+#define NUM_MAPPED_EXCEPTIONS \
+  (sizeof(mapped_exceptions) / sizeof(mapped_exceptions[0]))
+
+value camljava_SetExceptionMapping(value vflag)
+{
+  exception_mapping = Bool_val(vflag);
+  return Val_unit;
+}
+
+static const value * exception_constructor(jthrowable exn)
+{
+  static const value * camljava_exception = NULL;
+  const value * constr;
+  unsigned int i;
+
+  if (exception_mapping) {
+    for (i = 0; i < NUM_MAPPED_EXCEPTIONS; i++) {
+      if (mapped_exceptions[i].cls != NULL
+          && (*jenv)->IsInstanceOf(jenv, exn, mapped_exceptions[i].cls)) {
+        constr = caml_named_value(mapped_exceptions[i].caml_name);
+        if (constr != NULL) return constr;
+      }
+    }
+  }
+  if (camljava_exception == NULL) {
+    camljava_exception = caml_named_value("camljava_exception");
+    if (camljava_exception == NULL)
+      caml_invalid_argument("Java_lang not linked in");
+  }
+  return camljava_exception;
+}
+
 static void check_java_exception(void)
 {
   jthrowable exn;
+  const value * constr;
   value vobj;
-  static const value * camljava_raise_exception = NULL;
 
+  if (! (*jenv)->ExceptionCheck(jenv)) return;
   exn = (*jenv)->ExceptionOccurred(jenv);
-  if (exn != NULL) {
-    if(debug) {
-      /* For debugging */
-      (*jenv)->ExceptionDescribe(jenv);
-    }
-    (*jenv)->ExceptionClear(jenv);
-    /* TODO: check Caml exception embedded into Java exception */
-    if (camljava_raise_exception == NULL) {
-      camljava_raise_exception = caml_named_value("camljava_raise_exception");
-      if (camljava_raise_exception == NULL)
-        caml_invalid_argument("Java_lang not linked in");
-    }
-    vobj = caml_alloc_jobject(exn);
-    (*jenv)->DeleteLocalRef(jenv, exn);
-    caml_callback(*camljava_raise_exception, vobj);
+  if(debug) {
+    /* For debugging */
+    (*jenv)->ExceptionDescribe(jenv);
   }
+  (*jenv)->ExceptionClear(jenv);
+  /* TODO: check Caml exception embedded into Java exception */
+  constr = exception_constructor(exn);
+  vobj = caml_alloc_jobject_global(exn);
+  (*jenv)->DeleteLocalRef(jenv, exn);
+  Stat_incr(STAT_EXCEPTIONS_RAISED);
+  caml_raise_with_arg(*constr, vobj);
 }
 
 static void check_non_null(value jobj)
 {
   static const value * camljava_null_pointer;
+  check_not_critical();
   if (JObject(jobj) != NULL) return;
   if (camljava_null_pointer == NULL) {
     camljava_null_pointer = caml_named_value("camljava_null_pointer");
@@ -118,13 +651,285 @@ static void check_non_null(value jobj)
   caml_raise_constant(*camljava_null_pointer);
 }
 
+/*********** Local frames *************/
+
+value camljava_PushLocalFrame(value vcapacity)
+{
+  int64_t * newframes;
+
+  if ((*jenv)->PushLocalFrame(jenv, Int_val(vcapacity)) < 0) {
+    check_java_exception();
+    caml_raise_out_of_memory();
+  }
+  if (num_live_frames >= max_live_frames) {
+    newframes = realloc(live_frames, (max_live_frames + 16) * sizeof(int64_t));
+    if (newframes == NULL) {
+      (*jenv)->PopLocalFrame(jenv, NULL);
+      caml_raise_out_of_memory();
+    }
+    live_frames = newframes;
+    max_live_frames += 16;
+  }
+  live_frames[num_live_frames++] = Counter_add(last_frame, 1) + 1;
+  local_frame_depth++;
+  return Val_unit;
+}
+
+value camljava_PopLocalFrame(value unit)
+{
+  num_live_frames--;
+  local_frame_depth--;
+  (*jenv)->PopLocalFrame(jenv, NULL);
+  return Val_unit;
+}
+
+value camljava_NewGlobalRef(value vobj)
+{
+  if (Custom_ops_val(vobj) != &jobject_local_ops) return vobj;
+  return caml_alloc_jobject_global(JObject(vobj));
+}
+
+/*********** ID cache ************/
+
+/* Classes, field IDs and method IDs are resolved once, then cached by
+   (kind, class, name, descriptor).  Later lookups return the same Caml
+   handles, which are registered as global roots.  Classes are held
+   as global references, even when looked up inside a local frame.
+   Classes are keyed by name only, so only classes resolved by the
+   system class loader are cached.  [FindClass] uses the class loader
+   of the native method being run, if any: classes looked up during a
+   Java->Caml callback, or when the JVM was not created by this code,
+   are resolved anew each time. */
+
+enum { ID_CLASS, ID_FIELD, ID_STATIC_FIELD, ID_METHOD, ID_STATIC_METHOD };
+
+/* Number of Java->Caml callbacks running in this thread */
+static THREAD_LOCAL int callback_depth = 0;
+
+#define Cache_classes (jvm_owned && callback_depth == 0)
+
+struct id_entry {
+  struct id_entry * next;
+  int kind;
+  unsigned int hash;
+  jclass cls;                   /* global reference; NULL for ID_CLASS */
+  char * name;
+  char * sig;                   /* NULL for ID_CLASS */
+  value handle;                 /* generational global root */
+};
+
+#define ID_CACHE_SIZE 1024
+
+static struct id_entry * id_cache[ID_CACHE_SIZE];
+static uintnat id_cache_hits = 0, id_cache_misses = 0;
+
+#ifdef _WIN32
+static SRWLOCK id_cache_lock = SRWLOCK_INIT;
+#define Lock_id_cache() AcquireSRWLockExclusive(&id_cache_lock)
+#define Unlock_id_cache() ReleaseSRWLockExclusive(&id_cache_lock)
+#else
+static pthread_mutex_t id_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define Lock_id_cache() pthread_mutex_lock(&id_cache_lock)
+#define Unlock_id_cache() pthread_mutex_unlock(&id_cache_lock)
+#endif
+
+static unsigned int id_hash(int kind, const char * name, const char * sig)
+{
+  unsigned int h = 2166136261U + kind;
+  for (/*nothing*/; *name != 0; name++) h = (h ^ (unsigned char) *name) * 16777619U;
+  if (sig != NULL)
+    for (/*nothing*/; *sig != 0; sig++) h = (h ^ (unsigned char) *sig) * 16777619U;
+  return h;
+}
+
+/* Must be called with the cache locked.  [jenv] can raise, and would
+   then leave the cache locked: callers fetch [env] before locking. */
+static struct id_entry * id_cache_search(JNIEnv * env, int kind,
+                                         unsigned int h, jclass cls,
+                                         const char * name, const char * sig)
+{
+  struct id_entry * e;
+  for (e = id_cache[h % ID_CACHE_SIZE]; e != NULL; e = e->next) {
+    if (e->hash == h && e->kind == kind
+        && strcmp(e->name, name) == 0
+        && (sig == NULL || strcmp(e->sig, sig) == 0)
+        && (cls == NULL || (*env)->IsSameObject(env, e->cls, cls)))
+      return e;
+  }
+  return NULL;
+}
+
+static int id_cache_find(int kind, jclass cls,
+                         const char * name, const char * sig, value * res)
+{
+  JNIEnv * env = jenv;
+  struct id_entry * e;
+  unsigned int h = id_hash(kind, name, sig);
+  Lock_id_cache();
+  e = id_cache_search(env, kind, h, cls, name, sig);
+  if (e != NULL) { *res = e->handle; id_cache_hits++; } else id_cache_misses++;
+  Unlock_id_cache();
+  return e != NULL;
+}
+
+static char * id_strdup(const char * s)
+{
+  char * r = malloc(strlen(s) + 1);
+  if (r != NULL) strcpy(r, s);
+  return r;
+}
+
+/* Record a freshly resolved handle.  If another thread resolved the same
+   ID in the meantime, its handle is returned instead. */
+static value id_cache_add(int kind, jclass cls,
+                          const char * name, const char * sig, value handle)
+{
+  JNIEnv * env = jenv;
+  struct id_entry * e;
+  unsigned int h = id_hash(kind, name, sig);
+  Lock_id_cache();
+  e = id_cache_search(env, kind, h, cls, name, sig);
+  if (e != NULL) {
+    handle = e->handle;
+  } else if ((e = malloc(sizeof(struct id_entry))) != NULL) {
+    e->kind = kind;
+    e->hash = h;
+    e->cls = cls == NULL ? NULL : (*env)->NewGlobalRef(env, cls);
+    e->name = id_strdup(name);
+    e->sig = sig == NULL ? NULL : id_strdup(sig);
+    if ((cls != NULL && e->cls == NULL) || e->name == NULL
+        || (sig != NULL && e->sig == NULL)) {
+      /* Out of memory: do not cache */
+      if (e->cls != NULL) (*env)->DeleteGlobalRef(env, e->cls);
+      free(e->name); free(e->sig); free(e);
+    } else {
+      e->handle = handle;
+      caml_register_generational_global_root(&e->handle);
+      e->next = id_cache[h % ID_CACHE_SIZE];
+      id_cache[h % ID_CACHE_SIZE] = e;
+    }
+  }
+  Unlock_id_cache();
+  return handle;
+}
+
+value camljava_IdCacheStats(value unit)
+{
+  value res = caml_alloc_small(2, 0);
+  Field(res, 0) = Val_long(id_cache_hits);
+  Field(res, 1) = Val_long(id_cache_misses);
+  return res;
+}
+
+/* Handles already returned remain valid after the cache is cleared. */
+value camljava_IdCacheClear(value unit)
+{
+  JNIEnv * env;
+  struct id_entry * e, * next;
+  int i;
+  check_not_critical();
+  env = jenv;
+  Lock_id_cache();
+  for (i = 0; i < ID_CACHE_SIZE; i++) {
+    for (e = id_cache[i]; e != NULL; e = next) {
+      next = e->next;
+      caml_remove_generational_global_root(&e->handle);
+      if (e->cls != NULL) (*env)->DeleteGlobalRef(env, e->cls);
+      free(e->name); free(e->sig); free(e);
+    }
+    id_cache[i] = NULL;
+  }
+  id_cache_hits = id_cache_misses = 0;
+  Unlock_id_cache();
+  return Val_unit;
+}
+
 /*********** Class operations ************/
 
+/* Classes listed (separated by commas or blanks) in the environment
+   variable CAMLJAVA_PRELOAD are loaded at initialization, and entered
+   in the cache on first lookup.  Classes that cannot be found are
+   ignored.  The JVM may be started lazily from any stub, which must
+   not allocate in the Caml heap: the loaded classes are kept in this
+   list, written before [jvm_initialized] is set and only read after.
+   Called with the start-up lock held: must not raise. */
+
+struct preloaded_class {
+  char * name;
+  jclass cls;                   /* global reference */
+  struct preloaded_class * next;
+};
+
+static struct preloaded_class * preloaded_classes = NULL;
+
+static void preload_classes(JNIEnv * env, const char * list)
+{
+  const char * p, * q;
+  struct preloaded_class * pc;
+  char * name;
+  jclass c;
+
+  for (p = list; *p != 0; p = q) {
+    while (*p == ',' || *p == ' ' || *p == '\t' || *p == '\n') p++;
+    for (q = p; *q != 0 && *q != ',' && *q != ' '
+                && *q != '\t' && *q != '\n'; q++) /*nothing*/;
+    if (q == p) break;
+    name = caml_stat_alloc_noexc(q - p + 1);
+    if (name == NULL) break;
+    memcpy(name, p, q - p);
+    name[q - p] = 0;
+    c = (*env)->FindClass(env, name);
+    if (c == NULL) {
+      (*env)->ExceptionClear(env);
+      caml_stat_free(name);
+      continue;
+    }
+    pc = caml_stat_alloc_noexc(sizeof(struct preloaded_class));
+    if (pc == NULL) {
+      (*env)->DeleteLocalRef(env, c);
+      caml_stat_free(name);
+      break;
+    }
+    pc->name = name;
+    pc->cls = (*env)->NewGlobalRef(env, c);
+    pc->next = preloaded_classes;
+    (*env)->DeleteLocalRef(env, c);
+    if (pc->cls == NULL) { caml_stat_free(name); caml_stat_free(pc); continue; }
+    preloaded_classes = pc;
+  }
+}
+
+static jclass find_preloaded_class(const char * name)
+{
+  struct preloaded_class * pc;
+  for (pc = preloaded_classes; pc != NULL; pc = pc->next)
+    if (strcmp(pc->name, name) == 0) return pc->cls;
+  return NULL;
+}
+
 value camljava_FindClass(value vname)
 {
-  jclass c = (*jenv)->FindClass(jenv, String_val(vname));
-  if (c == NULL) check_java_exception();
-  return caml_alloc_jobject(c);
+  JNIEnv * env;
+  value res;
+  jclass c;
+  int local = 0, cached;
+  env = jenv;
+  cached = Cache_classes;
+  if (cached && id_cache_find(ID_CLASS, NULL, String_val(vname), NULL, &res))
+    return res;
+  c = cached ? find_preloaded_class(String_val(vname)) : NULL;
+  if (c == NULL) {
+    c = (*env)->FindClass(env, String_val(vname));
+    if (c == NULL) check_java_exception();
+    local = 1;
+  }
+  Begin_root(vname);
+    res = caml_alloc_jobject_global(c);
+    if (local) (*env)->DeleteLocalRef(env, c);
+    if (cached)
+      res = id_cache_add(ID_CLASS, NULL, String_val(vname), NULL, res);
+  End_roots();
+  return res;
 }
 
 value camljava_GetSuperclass(value vclass)
@@ -143,30 +948,84 @@ value camljava_IsAssignableFrom(value vclass1, value vclass2)
 
 /*********** Field IDs ***************/
 
-#define JField(v) (*((jfieldID *) (v)))
+struct camljava_field {
+  jfieldID id;
+  int result_size;              /* see alloc_result */
+};
+
+#define JField(v) (((struct camljava_field *) (v))->id)
+#define JFieldResultSize(v) (((struct camljava_field *) (v))->result_size)
 
-static value caml_alloc_jfieldID(jfieldID id)
+static value caml_alloc_jfieldID(jfieldID id, int result_size)
 {
-  value v = caml_alloc((sizeof(jfieldID) + sizeof(value) - 1) / sizeof(value),
-                  Abstract_tag);
+  value v = caml_alloc((sizeof(struct camljava_field) + sizeof(value) - 1)
+                       / sizeof(value),
+                       Abstract_tag);
   JField(v) = id;
+  JFieldResultSize(v) = result_size;
   return v;
 }
 
-value camljava_GetFieldID(value vclass, value vname, value vsig)
+static value caml_alloc_jmethodID(jmethodID id, int blocking,
+                                  int result_size);
+
+/* Size of the elements of the array type [sig], 0 if not an array */
+
+static int array_element_size(const char * sig)
+{
+  if (sig[0] != '[') return 0;
+  switch (sig[1]) {
+  case 'Z': case 'B': return 1;
+  case 'C': case 'S': return 2;
+  case 'I': case 'F': return 4;
+  case 'J': case 'D': return 8;
+  default: return sizeof(jobject);
+  }
+}
+
+static value get_member_id(int kind, value vclass, value vname, value vsig)
 {
-  jfieldID id = (*jenv)->GetFieldID(jenv, JObject(vclass),
-                                    String_val(vname), String_val(vsig));
+  value res;
+  jclass cls = JObject(vclass);
+  char * name = (char *) String_val(vname);
+  char * sig = (char *) String_val(vsig);
+  void * id;
+  char * restype;
+
+  if (id_cache_find(kind, cls, name, sig, &res)) return res;
+  switch (kind) {
+  case ID_FIELD:
+    id = (*jenv)->GetFieldID(jenv, cls, name, sig); break;
+  case ID_STATIC_FIELD:
+    id = (*jenv)->GetStaticFieldID(jenv, cls, name, sig); break;
+  case ID_METHOD:
+    id = (*jenv)->GetMethodID(jenv, cls, name, sig); break;
+  default:
+    id = (*jenv)->GetStaticMethodID(jenv, cls, name, sig); break;
+  }
   if (id == NULL) check_java_exception();
-  return caml_alloc_jfieldID(id);
+  restype = strchr(sig, ')');
+  restype = restype == NULL ? sig : restype + 1;
+  Begin_roots3(vclass, vname, vsig);
+    if (kind == ID_FIELD || kind == ID_STATIC_FIELD)
+      res = caml_alloc_jfieldID((jfieldID) id, array_element_size(restype));
+    else
+      res = caml_alloc_jmethodID((jmethodID) id, 0,
+                                 array_element_size(restype));
+    res = id_cache_add(kind, JObject(vclass),
+                       String_val(vname), String_val(vsig), res);
+  End_roots();
+  return res;
+}
+
+value camljava_GetFieldID(value vclass, value vname, value vsig)
+{
+  return get_member_id(ID_FIELD, vclass, vname, vsig);
 }
 
 value camljava_GetStaticFieldID(value vclass, value vname, value vsig)
 {
-  jfieldID id = (*jenv)->GetStaticFieldID(jenv, JObject(vclass),
-                                          String_val(vname), String_val(vsig));
-  if (id == NULL) check_java_exception();
-  return caml_alloc_jfieldID(id);
+  return get_member_id(ID_STATIC_FIELD, vclass, vname, vsig);
 }
 
 /*********** Field access *************/
@@ -176,11 +1035,14 @@ value camljava_##name(value vobj, value vfield)                             \
 {                                                                           \
   restyp res;                                                               \
   check_non_null(vobj);                                                     \
+  Stat_incr(STAT_FIELD_ACCESSES);                                           \
   res = (*jenv)->name(jenv, JObject(vobj), JField(vfield));                 \
   return resconv(res);                                                      \
 }
 
-GETFIELD(GetObjectField, jobject, caml_alloc_jobject)
+#define Field_result(r) alloc_result(r, JFieldResultSize(vfield))
+
+GETFIELD(GetObjectField, jobject, Field_result)
 GETFIELD(GetBooleanField, jboolean, Val_jboolean)
 GETFIELD(GetByteField, jbyte, Val_int)
 GETFIELD(GetCharField, jchar, Val_int)
@@ -194,15 +1056,33 @@ value camljava_GetCamlintField(value vobj, value vfield)
 {
   jint res;
   check_non_null(vobj);
+  Stat_incr(STAT_FIELD_ACCESSES);
   res = (*jenv)->GetIntField(jenv, JObject(vobj), JField(vfield));
   return Val_int(res);
 }
 
+/* Native-code variants of the accessors for boxed types: they return
+   and take unboxed numbers (see the [@unboxed] externals in jni.ml). */
+
+#define GETFIELDUNBOXED(name,restyp)                                        \
+restyp camljava_##name##_unboxed(value vobj, value vfield)                  \
+{                                                                           \
+  check_non_null(vobj);                                                     \
+  Stat_incr(STAT_FIELD_ACCESSES);                                           \
+  return (*jenv)->name(jenv, JObject(vobj), JField(vfield));                \
+}
+
+GETFIELDUNBOXED(GetIntField, int32_t)
+GETFIELDUNBOXED(GetLongField, int64_t)
+GETFIELDUNBOXED(GetFloatField, double)
+GETFIELDUNBOXED(GetDoubleField, double)
+
 #define SETFIELD(name,argtyp,argconv)                                       \
 value camljava_##name(value vobj, value vfield, value vnewval)              \
 {                                                                           \
   argtyp arg = argconv(vnewval);                                            \
   check_non_null(vobj);                                                     \
+  Stat_incr(STAT_FIELD_ACCESSES);                                           \
   (*jenv)->name(jenv, JObject(vobj), JField(vfield), arg);                  \
   return Val_unit;                                                          \
 }
@@ -221,18 +1101,34 @@ value camljava_SetCamlintField(value vobj, value vfield, value vnewval)
 {
   jint arg = Int_val(vnewval);
   check_non_null(vobj);
+  Stat_incr(STAT_FIELD_ACCESSES);
   (*jenv)->SetIntField(jenv, JObject(vobj), JField(vfield), arg);
   return Val_unit;
 }
 
+#define SETFIELDUNBOXED(name,argtyp)                                        \
+value camljava_##name##_unboxed(value vobj, value vfield, argtyp newval)    \
+{                                                                           \
+  check_non_null(vobj);                                                     \
+  Stat_incr(STAT_FIELD_ACCESSES);                                           \
+  (*jenv)->name(jenv, JObject(vobj), JField(vfield), newval);               \
+  return Val_unit;                                                          \
+}
+
+SETFIELDUNBOXED(SetIntField, int32_t)
+SETFIELDUNBOXED(SetLongField, int64_t)
+SETFIELDUNBOXED(SetFloatField, double)
+SETFIELDUNBOXED(SetDoubleField, double)
+
 #define GETSTATICFIELD(name,restyp,resconv)                                   \
 value camljava_##name(value vclass, value vfield)                             \
 {                                                                             \
   restyp res = (*jenv)->name(jenv, JObject(vclass), JField(vfield));          \
+  Stat_incr(STAT_FIELD_ACCESSES);                                             \
   return resconv(res);                                                        \
 }
 
-GETSTATICFIELD(GetStaticObjectField, jobject, caml_alloc_jobject)
+GETSTATICFIELD(GetStaticObjectField, jobject, Field_result)
 GETSTATICFIELD(GetStaticBooleanField, jboolean, Val_jboolean)
 GETSTATICFIELD(GetStaticByteField, jbyte, Val_int)
 GETSTATICFIELD(GetStaticCharField, jchar, Val_int)
@@ -245,13 +1141,27 @@ GETSTATICFIELD(GetStaticDoubleField, jdouble, caml_copy_double)
 value camljava_GetStaticCamlintField(value vclass, value vfield)
 {
   jint res = (*jenv)->GetStaticIntField(jenv, JObject(vclass), JField(vfield));
+  Stat_incr(STAT_FIELD_ACCESSES);
   return Val_int(res);
 }
 
+#define GETSTATICFIELDUNBOXED(name,restyp)                                    \
+restyp camljava_##name##_unboxed(value vclass, value vfield)                  \
+{                                                                             \
+  Stat_incr(STAT_FIELD_ACCESSES);                                             \
+  return (*jenv)->name(jenv, JObject(vclass), JField(vfield));                \
+}
+
+GETSTATICFIELDUNBOXED(GetStaticIntField, int32_t)
+GETSTATICFIELDUNBOXED(GetStaticLongField, int64_t)
+GETSTATICFIELDUNBOXED(GetStaticFloatField, double)
+GETSTATICFIELDUNBOXED(GetStaticDoubleField, double)
+
 #define SETSTATICFIELD(name,argtyp,argconv)                                   \
 value camljava_##name(value vclass, value vfield, value vnewval)              \
 {                                                                             \
   argtyp arg = argconv(vnewval);                                              \
+  Stat_incr(STAT_FIELD_ACCESSES);                                             \
   (*jenv)->name(jenv, JObject(vclass), JField(vfield), arg);                  \
   return Val_unit;                                                            \
 }
@@ -269,37 +1179,61 @@ SETSTATICFIELD(SetStaticDoubleField, jdouble, Double_val)
 value camljava_SetStaticCamlintField(value vclass, value vfield, value vnewval)
 {
   jint arg = Val_int(vnewval);
+  Stat_incr(STAT_FIELD_ACCESSES);
   (*jenv)->SetStaticIntField(jenv, JObject(vclass), JField(vfield), arg);
   return Val_unit;
 }
 
+#define SETSTATICFIELDUNBOXED(name,argtyp)                                    \
+value camljava_##name##_unboxed(value vclass, value vfield, argtyp newval)    \
+{                                                                             \
+  Stat_incr(STAT_FIELD_ACCESSES);                                             \
+  (*jenv)->name(jenv, JObject(vclass), JField(vfield), newval);               \
+  return Val_unit;                                                            \
+}
+
+SETSTATICFIELDUNBOXED(SetStaticIntField, int32_t)
+SETSTATICFIELDUNBOXED(SetStaticLongField, int64_t)
+SETSTATICFIELDUNBOXED(SetStaticFloatField, double)
+SETSTATICFIELDUNBOXED(SetStaticDoubleField, double)
+
 /*********** Method IDs ***************/
 
-#define JMethod(v) (*((jmethodID *) (v)))
+struct camljava_method {
+  jmethodID id;
+  int blocking;                 /* release the Caml runtime during calls */
+  int result_size;              /* see alloc_result */
+};
+
+#define JMethod(v) (((struct camljava_method *) (v))->id)
+#define JMethodBlocking(v) (((struct camljava_method *) (v))->blocking)
+#define JMethodResultSize(v) (((struct camljava_method *) (v))->result_size)
 
-static value caml_alloc_jmethodID(jmethodID id)
+static value caml_alloc_jmethodID(jmethodID id, int blocking,
+                                  int result_size)
 {
-  value v = caml_alloc((sizeof(jmethodID) + sizeof(value) - 1) / sizeof(value),
-                  Abstract_tag);
+  value v = caml_alloc((sizeof(struct camljava_method) + sizeof(value) - 1)
+                       / sizeof(value),
+                       Abstract_tag);
   JMethod(v) = id;
+  JMethodBlocking(v) = blocking;
+  JMethodResultSize(v) = result_size;
   return v;
 }
 
 value camljava_GetMethodID(value vclass, value vname, value vsig)
 {
-  jmethodID id = (*jenv)->GetMethodID(jenv, JObject(vclass),
-                                      String_val(vname), String_val(vsig));
-  if (id == NULL) check_java_exception();
-  return caml_alloc_jmethodID(id);
+  return get_member_id(ID_METHOD, vclass, vname, vsig);
 }
 
 value camljava_GetStaticMethodID(value vclass, value vname, value vsig)
 {
-  jmethodID id =
-    (*jenv)->GetStaticMethodID(jenv, JObject(vclass),
-                               String_val(vname), String_val(vsig));
-  if (id == NULL) check_java_exception();
-  return caml_alloc_jmethodID(id);
+  return get_member_id(ID_STATIC_METHOD, vclass, vname, vsig);
+}
+
+value camljava_BlockingMethod(value vmeth)
+{
+  return caml_alloc_jmethodID(JMethod(vmeth), 1, JMethodResultSize(vmeth));
 }
 
 /*************** The jvalue union ***************/
@@ -351,38 +1285,81 @@ static jvalue * convert_args(value vargs, jvalue default_args[])
 
 /************* Method invocation **************/
 
-#define CALLMETHOD(callname,restyp,resconv)                                 \
+/* Methods marked as blocking are invoked with the Caml runtime
+   released, so that other Caml threads can run meanwhile.  The Caml
+   values that own the object references passed to Java are registered
+   as roots for the duration of the call.  [call] must neither read
+   Caml values nor use [jenv], which can raise or start the JVM: it
+   uses the environment [env] fetched beforehand. */
+
+static THREAD_LOCAL int in_blocking_call = 0;
+
+#define INVOKE(stat,vmeth,roots,call)                                       \
+  Stat_incr(stat);                                                          \
+  if (JMethodBlocking(vmeth)) {                                             \
+    roots                                                                   \
+      in_blocking_call = 1;                                                 \
+      TIMED(caml_enter_blocking_section();                                  \
+            call;                                                           \
+            caml_leave_blocking_section());                                 \
+      in_blocking_call = 0;                                                 \
+    End_roots();                                                            \
+  } else {                                                                  \
+    TIMED(call);                                                            \
+  }
+
+#define CALLMETHOD(callname,restyp,ressize,resconv)                         \
 value camljava_##callname(value vobj, value vmeth, value vargs)             \
 {                                                                           \
+  JNIEnv * env = jenv;                                                      \
   jvalue default_args[NUM_DEFAULT_ARGS];                                    \
   jvalue * args;                                                            \
+  jobject obj;                                                              \
+  jmethodID meth;                                                           \
   restyp res;                                                               \
+  ressize(vmeth)                                                            \
   check_non_null(vobj);                                                     \
+  obj = JObject(vobj);                                                      \
+  meth = JMethod(vmeth);                                                    \
   args = convert_args(vargs, default_args);                                 \
-  res = (*jenv)->callname##A(jenv, JObject(vobj), JMethod(vmeth), args);    \
-  if (args != default_args) caml_stat_free(args);                                \
+  INVOKE(STAT_VIRTUAL_CALLS, vmeth, Begin_roots2(vobj, vargs),              \
+         res = (*env)->callname##A(env, obj, meth, args));                  \
+  if (args != default_args) caml_stat_free(args);                           \
   check_java_exception();                                                   \
   return resconv(res);                                                      \
 }
 
-CALLMETHOD(CallObjectMethod, jobject, caml_alloc_jobject)
-CALLMETHOD(CallBooleanMethod, jboolean, Val_jboolean)
-CALLMETHOD(CallByteMethod, jbyte, Val_int)
-CALLMETHOD(CallCharMethod, jchar, Val_int)
-CALLMETHOD(CallShortMethod, jshort, Val_int)
-CALLMETHOD(CallIntMethod, jint, caml_copy_int32)
-CALLMETHOD(CallLongMethod, jlong, caml_copy_int64)
-CALLMETHOD(CallFloatMethod, jfloat, caml_copy_double)
-CALLMETHOD(CallDoubleMethod, jdouble, caml_copy_double)
+/* [vmeth] may have moved during the call: the size of array results
+   is read beforehand into [rsize], declared by [Result_size] for
+   object results only. */
+#define Result_size(vmeth) int rsize = JMethodResultSize(vmeth);
+#define No_result_size(vmeth)
+#define Method_result(r) alloc_result(r, rsize)
+
+CALLMETHOD(CallObjectMethod, jobject, Result_size, Method_result)
+CALLMETHOD(CallBooleanMethod, jboolean, No_result_size, Val_jboolean)
+CALLMETHOD(CallByteMethod, jbyte, No_result_size, Val_int)
+CALLMETHOD(CallCharMethod, jchar, No_result_size, Val_int)
+CALLMETHOD(CallShortMethod, jshort, No_result_size, Val_int)
+CALLMETHOD(CallIntMethod, jint, No_result_size, caml_copy_int32)
+CALLMETHOD(CallLongMethod, jlong, No_result_size, caml_copy_int64)
+CALLMETHOD(CallFloatMethod, jfloat, No_result_size, caml_copy_double)
+CALLMETHOD(CallDoubleMethod, jdouble, No_result_size, caml_copy_double)
 
 value camljava_CallCamlintMethod(value vobj, value vmeth, value vargs)
 {
+  JNIEnv * env = jenv;
   jvalue default_args[NUM_DEFAULT_ARGS];
   jvalue * args;
+  jobject obj;
+  jmethodID meth;
   jint res;
   check_non_null(vobj);
+  obj = JObject(vobj);
+  meth = JMethod(vmeth);
   args = convert_args(vargs, default_args);
-  res = (*jenv)->CallIntMethodA(jenv, JObject(vobj), JMethod(vmeth), args);
+  INVOKE(STAT_VIRTUAL_CALLS, vmeth, Begin_roots2(vobj, vargs),
+         res = (*env)->CallIntMethodA(env, obj, meth, args));
   if (args != default_args) caml_stat_free(args);
   check_java_exception();
   return Val_int(res);
@@ -390,44 +1367,61 @@ value camljava_CallCamlintMethod(value vobj, value vmeth, value vargs)
 
 value camljava_CallVoidMethod(value vobj, value vmeth, value vargs)
 {
+  JNIEnv * env = jenv;
   jvalue default_args[NUM_DEFAULT_ARGS];
   jvalue * args;
+  jobject obj;
+  jmethodID meth;
   check_non_null(vobj);
+  obj = JObject(vobj);
+  meth = JMethod(vmeth);
   args = convert_args(vargs, default_args);
-  (*jenv)->CallVoidMethodA(jenv, JObject(vobj), JMethod(vmeth), args);
+  INVOKE(STAT_VIRTUAL_CALLS, vmeth, Begin_roots2(vobj, vargs),
+         (*env)->CallVoidMethodA(env, obj, meth, args));
   if (args != default_args) caml_stat_free(args);
   check_java_exception();
   return Val_unit;
 }
 
-#define CALLSTATICMETHOD(callname,restyp,resconv)                           \
+#define CALLSTATICMETHOD(callname,restyp,ressize,resconv)                   \
 value camljava_##callname(value vclass, value vmeth, value vargs)           \
 {                                                                           \
+  JNIEnv * env = jenv;                                                      \
   jvalue default_args[NUM_DEFAULT_ARGS];                                    \
   jvalue * args = convert_args(vargs, default_args);                        \
-  restyp res =                                                              \
-    (*jenv)->callname##A(jenv, JObject(vclass), JMethod(vmeth), args);      \
-  if (args != default_args) caml_stat_free(args);                                \
+  jclass cls = JObject(vclass);                                             \
+  jmethodID meth = JMethod(vmeth);                                          \
+  restyp res;                                                               \
+  ressize(vmeth)                                                            \
+  INVOKE(STAT_STATIC_CALLS, vmeth, Begin_roots2(vclass, vargs),             \
+         res = (*env)->callname##A(env, cls, meth, args));                  \
+  if (args != default_args) caml_stat_free(args);                           \
   check_java_exception();                                                   \
   return resconv(res);                                                      \
 }
 
-CALLSTATICMETHOD(CallStaticObjectMethod, jobject, caml_alloc_jobject)
-CALLSTATICMETHOD(CallStaticBooleanMethod, jboolean, Val_int)
-CALLSTATICMETHOD(CallStaticByteMethod, jbyte, Val_int)
-CALLSTATICMETHOD(CallStaticCharMethod, jchar, Val_int)
-CALLSTATICMETHOD(CallStaticShortMethod, jshort, Val_int)
-CALLSTATICMETHOD(CallStaticIntMethod, jint, caml_copy_int32)
-CALLSTATICMETHOD(CallStaticLongMethod, jlong, caml_copy_int64)
-CALLSTATICMETHOD(CallStaticFloatMethod, jfloat, caml_copy_double)
-CALLSTATICMETHOD(CallStaticDoubleMethod, jdouble, caml_copy_double)
+CALLSTATICMETHOD(CallStaticObjectMethod, jobject, Result_size, Method_result)
+CALLSTATICMETHOD(CallStaticBooleanMethod, jboolean, No_result_size, Val_int)
+CALLSTATICMETHOD(CallStaticByteMethod, jbyte, No_result_size, Val_int)
+CALLSTATICMETHOD(CallStaticCharMethod, jchar, No_result_size, Val_int)
+CALLSTATICMETHOD(CallStaticShortMethod, jshort, No_result_size, Val_int)
+CALLSTATICMETHOD(CallStaticIntMethod, jint, No_result_size, caml_copy_int32)
+CALLSTATICMETHOD(CallStaticLongMethod, jlong, No_result_size, caml_copy_int64)
+CALLSTATICMETHOD(CallStaticFloatMethod, jfloat,
+                 No_result_size, caml_copy_double)
+CALLSTATICMETHOD(CallStaticDoubleMethod, jdouble,
+                 No_result_size, caml_copy_double)
 
 value camljava_CallStaticCamlintMethod(value vclass, value vmeth, value vargs)
 {
+  JNIEnv * env = jenv;
   jvalue default_args[NUM_DEFAULT_ARGS];
   jvalue * args = convert_args(vargs, default_args);
-  jint res =
-    (*jenv)->CallStaticIntMethodA(jenv, JObject(vclass), JMethod(vmeth), args);
+  jclass cls = JObject(vclass);
+  jmethodID meth = JMethod(vmeth);
+  jint res;
+  INVOKE(STAT_STATIC_CALLS, vmeth, Begin_roots2(vclass, vargs),
+         res = (*env)->CallStaticIntMethodA(env, cls, meth, args));
   if (args != default_args) caml_stat_free(args);
   check_java_exception();
   return Val_int(res);
@@ -435,49 +1429,74 @@ value camljava_CallStaticCamlintMethod(value vclass, value vmeth, value vargs)
 
 value camljava_CallStaticVoidMethod(value vclass, value vmeth, value vargs)
 {
+  JNIEnv * env = jenv;
   jvalue default_args[NUM_DEFAULT_ARGS];
   jvalue * args = convert_args(vargs, default_args);
-  (*jenv)->CallStaticVoidMethodA(jenv, JObject(vclass), JMethod(vmeth), args);
+  jclass cls = JObject(vclass);
+  jmethodID meth = JMethod(vmeth);
+  INVOKE(STAT_STATIC_CALLS, vmeth, Begin_roots2(vclass, vargs),
+         (*env)->CallStaticVoidMethodA(env, cls, meth, args));
   if (args != default_args) caml_stat_free(args);
   check_java_exception();
   return Val_unit;
 }
 
-#define CALLNONVIRTUALMETHOD(callname,restyp,resconv)                       \
+#define CALLNONVIRTUALMETHOD(callname,restyp,ressize,resconv)               \
 value camljava_##callname(value vobj, value vclass, value vmeth, value vargs)\
 {                                                                           \
+  JNIEnv * env = jenv;                                                      \
   jvalue default_args[NUM_DEFAULT_ARGS];                                    \
   jvalue * args;                                                            \
+  jobject obj;                                                              \
+  jclass cls;                                                               \
+  jmethodID meth;                                                           \
   restyp res;                                                               \
+  ressize(vmeth)                                                            \
   check_non_null(vobj);                                                     \
+  obj = JObject(vobj);                                                      \
+  cls = JObject(vclass);                                                    \
+  meth = JMethod(vmeth);                                                    \
   args = convert_args(vargs, default_args);                                 \
-  res = (*jenv)->callname##A(jenv, JObject(vobj), JObject(vclass),          \
-                             JMethod(vmeth), args);                         \
-  if (args != default_args) caml_stat_free(args);                                \
+  INVOKE(STAT_NONVIRTUAL_CALLS, vmeth, Begin_roots3(vobj, vclass, vargs),   \
+         res = (*env)->callname##A(env, obj, cls, meth, args));             \
+  if (args != default_args) caml_stat_free(args);                           \
   check_java_exception();                                                   \
   return resconv(res);                                                      \
 }
 
-CALLNONVIRTUALMETHOD(CallNonvirtualObjectMethod, jobject, caml_alloc_jobject)
-CALLNONVIRTUALMETHOD(CallNonvirtualBooleanMethod, jboolean, Val_int)
-CALLNONVIRTUALMETHOD(CallNonvirtualByteMethod, jbyte, Val_int)
-CALLNONVIRTUALMETHOD(CallNonvirtualCharMethod, jchar, Val_int)
-CALLNONVIRTUALMETHOD(CallNonvirtualShortMethod, jshort, Val_int)
-CALLNONVIRTUALMETHOD(CallNonvirtualIntMethod, jint, caml_copy_int32)
-CALLNONVIRTUALMETHOD(CallNonvirtualLongMethod, jlong, caml_copy_int64)
-CALLNONVIRTUALMETHOD(CallNonvirtualFloatMethod, jfloat, caml_copy_double)
-CALLNONVIRTUALMETHOD(CallNonvirtualDoubleMethod, jdouble, caml_copy_double)
+CALLNONVIRTUALMETHOD(CallNonvirtualObjectMethod, jobject,
+                     Result_size, Method_result)
+CALLNONVIRTUALMETHOD(CallNonvirtualBooleanMethod, jboolean,
+                     No_result_size, Val_int)
+CALLNONVIRTUALMETHOD(CallNonvirtualByteMethod, jbyte, No_result_size, Val_int)
+CALLNONVIRTUALMETHOD(CallNonvirtualCharMethod, jchar, No_result_size, Val_int)
+CALLNONVIRTUALMETHOD(CallNonvirtualShortMethod, jshort, No_result_size, Val_int)
+CALLNONVIRTUALMETHOD(CallNonvirtualIntMethod, jint,
+                     No_result_size, caml_copy_int32)
+CALLNONVIRTUALMETHOD(CallNonvirtualLongMethod, jlong,
+                     No_result_size, caml_copy_int64)
+CALLNONVIRTUALMETHOD(CallNonvirtualFloatMethod, jfloat,
+                     No_result_size, caml_copy_double)
+CALLNONVIRTUALMETHOD(CallNonvirtualDoubleMethod, jdouble,
+                     No_result_size, caml_copy_double)
 
 value camljava_CallNonvirtualCamlintMethod(value vobj, value vclass,
                                            value vmeth, value vargs)
 {
+  JNIEnv * env = jenv;
   jvalue default_args[NUM_DEFAULT_ARGS];
   jvalue * args;
+  jobject obj;
+  jclass cls;
+  jmethodID meth;
   jint res;
   check_non_null(vobj);
+  obj = JObject(vobj);
+  cls = JObject(vclass);
+  meth = JMethod(vmeth);
   args = convert_args(vargs, default_args);
-  res = (*jenv)->CallNonvirtualIntMethodA(jenv, JObject(vobj), JObject(vclass),
-                                          JMethod(vmeth), args);
+  INVOKE(STAT_NONVIRTUAL_CALLS, vmeth, Begin_roots3(vobj, vclass, vargs),
+         res = (*env)->CallNonvirtualIntMethodA(env, obj, cls, meth, args));
   if (args != default_args) caml_stat_free(args);
   check_java_exception();
   return Val_int(res);
@@ -486,17 +1505,373 @@ value camljava_CallNonvirtualCamlintMethod(value vobj, value vclass,
 value camljava_CallNonvirtualVoidMethod(value vobj, value vclass,
                                         value vmeth, value vargs)
 {
+  JNIEnv * env = jenv;
   jvalue default_args[NUM_DEFAULT_ARGS];
   jvalue * args;
+  jobject obj;
+  jclass cls;
+  jmethodID meth;
   check_non_null(vobj);
+  obj = JObject(vobj);
+  cls = JObject(vclass);
+  meth = JMethod(vmeth);
   args = convert_args(vargs, default_args);
-  (*jenv)->CallNonvirtualVoidMethodA(jenv, JObject(vobj), JObject(vclass),
-                                     JMethod(vmeth), args);
+  INVOKE(STAT_NONVIRTUAL_CALLS, vmeth, Begin_roots3(vobj, vclass, vargs),
+         (*env)->CallNonvirtualVoidMethodA(env, obj, cls, meth, args));
   if (args != default_args) caml_stat_free(args);
   check_java_exception();
   return Val_unit;
 }
 
+/************** Fixed-arity method invocation **************/
+
+/* camljava_Call[Static]<R>Method<N><K> invokes a method with N
+   arguments (0 to 4), all of kind K (Obj, Int, Long or Double), and
+   result type R.  The native-code stubs take and return untagged or
+   unboxed numbers, so that no argument array or box is allocated;
+   the _byte stubs are used by the bytecode compiler. */
+
+enum { RES_VOID, RES_BOOLEAN, RES_CAMLINT, RES_INT, RES_LONG,
+       RES_DOUBLE, RES_OBJECT };
+
+static jvalue call_method_a(JNIEnv * env, int restyp, int is_static,
+                            jobject target, jmethodID meth, jvalue * args)
+{
+  jvalue res;
+  res.j = 0;
+  if (is_static) {
+    switch (restyp) {
+    case RES_VOID:
+      (*env)->CallStaticVoidMethodA(env, target, meth, args); break;
+    case RES_BOOLEAN:
+      res.z = (*env)->CallStaticBooleanMethodA(env, target, meth, args); break;
+    case RES_CAMLINT: case RES_INT:
+      res.i = (*env)->CallStaticIntMethodA(env, target, meth, args); break;
+    case RES_LONG:
+      res.j = (*env)->CallStaticLongMethodA(env, target, meth, args); break;
+    case RES_DOUBLE:
+      res.d = (*env)->CallStaticDoubleMethodA(env, target, meth, args); break;
+    default:
+      res.l = (*env)->CallStaticObjectMethodA(env, target, meth, args); break;
+    }
+  } else {
+    switch (restyp) {
+    case RES_VOID:
+      (*env)->CallVoidMethodA(env, target, meth, args); break;
+    case RES_BOOLEAN:
+      res.z = (*env)->CallBooleanMethodA(env, target, meth, args); break;
+    case RES_CAMLINT: case RES_INT:
+      res.i = (*env)->CallIntMethodA(env, target, meth, args); break;
+    case RES_LONG:
+      res.j = (*env)->CallLongMethodA(env, target, meth, args); break;
+    case RES_DOUBLE:
+      res.d = (*env)->CallDoubleMethodA(env, target, meth, args); break;
+    default:
+      res.l = (*env)->CallObjectMethodA(env, target, meth, args); break;
+    }
+  }
+  return res;
+}
+
+/* roots[0] is the object or class; the other roots are the object
+   arguments.  The size of array results is stored in [*rsize]. */
+static jvalue call_fixed(int restyp, int is_static, value vmeth,
+                         value * roots, int nroots, jvalue * args,
+                         int * rsize)
+{
+  JNIEnv * env = jenv;
+  jobject target;
+  jmethodID meth;
+  jvalue res;
+  if (! is_static) check_non_null(roots[0]);
+  target = JObject(roots[0]);
+  meth = JMethod(vmeth);
+  *rsize = JMethodResultSize(vmeth);
+  INVOKE(is_static ? STAT_STATIC_CALLS : STAT_VIRTUAL_CALLS,
+         vmeth, Begin_roots_block(roots, nroots),
+         res = call_method_a(env, restyp, is_static, target, meth, args));
+  check_java_exception();
+  return res;
+}
+
+#define Is_static_ 0
+#define Is_static_Static 1
+
+#define Res_Void value
+#define Res_Boolean value
+#define Res_Camlint intnat
+#define Res_Int int32_t
+#define Res_Long int64_t
+#define Res_Double double
+#define Res_Object value
+
+#define Code_Void RES_VOID
+#define Code_Boolean RES_BOOLEAN
+#define Code_Camlint RES_CAMLINT
+#define Code_Int RES_INT
+#define Code_Long RES_LONG
+#define Code_Double RES_DOUBLE
+#define Code_Object RES_OBJECT
+
+#define Nat_Void(r) ((void) (r), Val_unit)
+#define Nat_Boolean(r) Val_jboolean((r).z)
+#define Nat_Camlint(r) ((intnat) (r).i)
+#define Nat_Int(r) ((int32_t) (r).i)
+#define Nat_Long(r) ((int64_t) (r).j)
+#define Nat_Double(r) ((double) (r).d)
+#define Nat_Object(r) alloc_result((r).l, rsize)
+
+#define Byte_Void(r) ((void) (r), Val_unit)
+#define Byte_Boolean(r) Val_jboolean((r).z)
+#define Byte_Camlint(r) Val_long((r).i)
+#define Byte_Int(r) caml_copy_int32((r).i)
+#define Byte_Long(r) caml_copy_int64((r).j)
+#define Byte_Double(r) caml_copy_double((r).d)
+#define Byte_Object(r) alloc_result((r).l, rsize)
+
+#define Arg_Obj value
+#define Arg_Int intnat
+#define Arg_Long int64_t
+#define Arg_Double double
+
+#define Unbox_Obj(v) (v)
+#define Unbox_Int(v) Long_val(v)
+#define Unbox_Long(v) Int64_val(v)
+#define Unbox_Double(v) Double_val(v)
+
+#define Set_Obj(jv,x) ((jv).l = JObject(x), roots[nroots++] = (x))
+#define Set_Int(jv,x) ((jv).i = (jint) (x))
+#define Set_Long(jv,x) ((jv).j = (jlong) (x))
+#define Set_Double(jv,x) ((jv).d = (jdouble) (x))
+
+#define FIXEDBODY(P,R,conv,sets)                                            \
+  jvalue args[4];                                                           \
+  value roots[5];                                                           \
+  int nroots = 1;                                                           \
+  int rsize;                                                                \
+  jvalue res;                                                               \
+  roots[0] = vtarget;                                                       \
+  sets                                                                      \
+  res = call_fixed(Code_##R, Is_static_##P, vmeth, roots, nroots, args,     \
+                   &rsize);                                                 \
+  return conv##_##R(res);
+
+#define FIXED0(P,R)                                                         \
+Res_##R camljava_Call##P##R##Method0(value vtarget, value vmeth)            \
+{                                                                           \
+  value roots[1];                                                           \
+  int rsize;                                                                \
+  jvalue res;                                                               \
+  roots[0] = vtarget;                                                       \
+  res = call_fixed(Code_##R, Is_static_##P, vmeth, roots, 1, NULL, &rsize); \
+  return Nat_##R(res);                                                      \
+}                                                                           \
+value camljava_Call##P##R##Method0_byte(value vtarget, value vmeth)         \
+{                                                                           \
+  value roots[1];                                                           \
+  int rsize;                                                                \
+  jvalue res;                                                               \
+  roots[0] = vtarget;                                                       \
+  res = call_fixed(Code_##R, Is_static_##P, vmeth, roots, 1, NULL, &rsize); \
+  return Byte_##R(res);                                                     \
+}
+
+#define FIXED1(P,R,K)                                                       \
+Res_##R camljava_Call##P##R##Method1##K(value vtarget, value vmeth,         \
+                                        Arg_##K a1)                         \
+{                                                                           \
+  FIXEDBODY(P, R, Nat, Set_##K(args[0], a1);)                               \
+}                                                                           \
+value camljava_Call##P##R##Method1##K##_byte(value vtarget, value vmeth,    \
+                                             value a1)                      \
+{                                                                           \
+  FIXEDBODY(P, R, Byte, Set_##K(args[0], Unbox_##K(a1));)                   \
+}
+
+#define FIXED2(P,R,K)                                                       \
+Res_##R camljava_Call##P##R##Method2##K(value vtarget, value vmeth,         \
+                                        Arg_##K a1, Arg_##K a2)             \
+{                                                                           \
+  FIXEDBODY(P, R, Nat, Set_##K(args[0], a1); Set_##K(args[1], a2);)         \
+}                                                                           \
+value camljava_Call##P##R##Method2##K##_byte(value vtarget, value vmeth,    \
+                                             value a1, value a2)            \
+{                                                                           \
+  FIXEDBODY(P, R, Byte, Set_##K(args[0], Unbox_##K(a1));                    \
+                        Set_##K(args[1], Unbox_##K(a2));)                   \
+}
+
+#define FIXED3(P,R,K)                                                       \
+Res_##R camljava_Call##P##R##Method3##K(value vtarget, value vmeth,         \
+                                        Arg_##K a1, Arg_##K a2, Arg_##K a3) \
+{                                                                           \
+  FIXEDBODY(P, R, Nat, Set_##K(args[0], a1); Set_##K(args[1], a2);          \
+                       Set_##K(args[2], a3);)                               \
+}                                                                           \
+value camljava_Call##P##R##Method3##K##_byte(value vtarget, value vmeth,    \
+                                             value a1, value a2, value a3)  \
+{                                                                           \
+  FIXEDBODY(P, R, Byte, Set_##K(args[0], Unbox_##K(a1));                    \
+                        Set_##K(args[1], Unbox_##K(a2));                    \
+                        Set_##K(args[2], Unbox_##K(a3));)                   \
+}
+
+#define FIXED4(P,R,K)                                                       \
+Res_##R camljava_Call##P##R##Method4##K(value vtarget, value vmeth,         \
+                                        Arg_##K a1, Arg_##K a2,             \
+                                        Arg_##K a3, Arg_##K a4)             \
+{                                                                           \
+  FIXEDBODY(P, R, Nat, Set_##K(args[0], a1); Set_##K(args[1], a2);          \
+                       Set_##K(args[2], a3); Set_##K(args[3], a4);)         \
+}                                                                           \
+value camljava_Call##P##R##Method4##K##_byte(value * argv, int argn)        \
+{                                                                           \
+  value vtarget = argv[0], vmeth = argv[1];                                 \
+  FIXEDBODY(P, R, Byte, Set_##K(args[0], Unbox_##K(argv[2]));               \
+                        Set_##K(args[1], Unbox_##K(argv[3]));               \
+                        Set_##K(args[2], Unbox_##K(argv[4]));               \
+                        Set_##K(args[3], Unbox_##K(argv[5]));)              \
+}
+
+#define FIXEDKIND(P,R,K)                                                    \
+  FIXED1(P,R,K) FIXED2(P,R,K) FIXED3(P,R,K) FIXED4(P,R,K)
+
+#define FIXEDALL(P,R)                                                       \
+  FIXED0(P,R)                                                               \
+  FIXEDKIND(P,R,Obj) FIXEDKIND(P,R,Int)                                     \
+  FIXEDKIND(P,R,Long) FIXEDKIND(P,R,Double)
+
+FIXEDALL(,Void)
+FIXEDALL(,Boolean)
+FIXEDALL(,Camlint)
+FIXEDALL(,Int)
+FIXEDALL(,Long)
+FIXEDALL(,Double)
+FIXEDALL(,Object)
+FIXEDALL(Static,Void)
+FIXEDALL(Static,Boolean)
+FIXEDALL(Static,Camlint)
+FIXEDALL(Static,Int)
+FIXEDALL(Static,Long)
+FIXEDALL(Static,Double)
+FIXEDALL(Static,Object)
+
+/************** Batched method invocation **************/
+
+/* Invoke the same method on many receivers, taken from a Caml array
+   of objects or from a Java Object[] array.  [vargs] holds either no
+   arguments, one row of arguments shared by all calls, or one row per
+   receiver.  Results are stored in [vres]: nothing for void, a Caml
+   array for boolean, camlint and object results, a Bigarray for int,
+   long and double results.  Calls that fail (null receiver, Java
+   exception) leave their result slot unchanged and are reported in
+   the returned list of (index, exception object) pairs; the exception
+   object is null for null receivers. */
+
+static mlsize_t batch_results_length(int restyp, value vres)
+{
+  switch (restyp) {
+  case RES_VOID:
+    return (mlsize_t) -1;
+  case RES_INT: case RES_LONG: case RES_DOUBLE:
+    return Caml_ba_array_val(vres)->dim[0];
+  default:
+    return Wosize_val(vres);
+  }
+}
+
+static value batch_call(int restyp, value vmeth, value vrecv, int java_array,
+                        value vargs, value vres)
+{
+  JNIEnv * env = jenv;
+  jvalue default_args[NUM_DEFAULT_ARGS];
+  jvalue * args = NULL;
+  mlsize_t nrecv, nrows, i;
+  jobject recv;
+  jmethodID meth = JMethod(vmeth);
+  jthrowable exn;
+  jvalue res;
+  value vfailures = Val_emptylist, vexn = Val_unit, vpair = Val_unit, v;
+
+  if (java_array) {
+    check_non_null(vrecv);
+    nrecv = (*env)->GetArrayLength(env, JObject(vrecv));
+  } else {
+    check_not_critical();
+    nrecv = Wosize_val(vrecv);
+  }
+  nrows = Wosize_val(vargs);
+  if ((nrows > 1 && nrows != nrecv) || batch_results_length(restyp, vres) < nrecv)
+    caml_invalid_argument("Jni.batch_call");
+  if (nrows == 1) args = convert_args(Field(vargs, 0), default_args);
+  Stat_incr(STAT_BATCH_CALLS);
+  Begin_roots5(vmeth, vrecv, vargs, vres, vfailures);
+  Begin_roots2(vexn, vpair);
+  for (i = 0; i < nrecv; i++) {
+    if (java_array)
+      recv = (*env)->GetObjectArrayElement(env, JObject(vrecv), i);
+    else
+      recv = JObject(Field(vrecv, i));
+    if (recv == NULL) {
+      vexn = caml_alloc_jobject(NULL);
+    } else {
+      if (nrows > 1) args = convert_args(Field(vargs, i), default_args);
+      INVOKE(STAT_VIRTUAL_CALLS, vmeth, Begin_roots1(vmeth),
+             res = call_method_a(env, restyp, 0, recv, meth, args));
+      if (nrows > 1 && args != default_args) caml_stat_free(args);
+      if (java_array) (*env)->DeleteLocalRef(env, recv);
+      exn = (*env)->ExceptionOccurred(env);
+      if (exn == NULL) {
+        switch (restyp) {
+        case RES_BOOLEAN:
+          Field(vres, i) = Val_jboolean(res.z); break;
+        case RES_CAMLINT:
+          Field(vres, i) = Val_long(res.i); break;
+        case RES_INT:
+          ((int32_t *) Caml_ba_data_val(vres))[i] = res.i; break;
+        case RES_LONG:
+          ((int64_t *) Caml_ba_data_val(vres))[i] = res.j; break;
+        case RES_DOUBLE:
+          ((double *) Caml_ba_data_val(vres))[i] = res.d; break;
+        case RES_OBJECT:
+          v = alloc_result(res.l, JMethodResultSize(vmeth));
+          caml_modify(&Field(vres, i), v);
+          if (local_frame_depth == 0 && res.l != NULL)
+            (*env)->DeleteLocalRef(env, res.l);
+          break;
+        }
+        continue;
+      }
+      (*env)->ExceptionClear(env);
+      vexn = caml_alloc_jobject_global(exn);
+      (*env)->DeleteLocalRef(env, exn);
+    }
+    vpair = caml_alloc_small(2, 0);
+    Field(vpair, 0) = Val_long(i);
+    Field(vpair, 1) = vexn;
+    v = caml_alloc_small(2, 0);
+    Field(v, 0) = vpair;
+    Field(v, 1) = vfailures;
+    vfailures = v;
+  }
+  End_roots();
+  End_roots();
+  if (nrows == 1 && args != default_args) caml_stat_free(args);
+  return vfailures;
+}
+
+value camljava_BatchCall(value vrestyp, value vmeth, value vrecv,
+                         value vargs, value vres)
+{
+  return batch_call(Int_val(vrestyp), vmeth, vrecv, 0, vargs, vres);
+}
+
+value camljava_BatchCallOnJavaArray(value vrestyp, value vmeth, value varray,
+                                    value vargs, value vres)
+{
+  return batch_call(Int_val(vrestyp), vmeth, varray, 1, vargs, vres);
+}
+
 /************** Strings ********************/
 
 /* Note: by lack of wide strings in Caml, we map Java strings to
@@ -511,13 +1886,158 @@ value camljava_RegisterNullString(value null_string)
   return Val_unit;
 }
 
+/* Java strings are read as UTF-16 (GetStringRegion) and transcoded to
+   standard UTF-8 here, instead of going through the "modified UTF-8"
+   of GetStringUTFChars/NewStringUTF, which encodes NUL and
+   supplementary characters differently.  Unpaired surrogates and
+   malformed UTF-8 sequences are replaced by U+FFFD.  Runs of ASCII
+   characters are processed 4 (UTF-16) or 8 (UTF-8) units at a time. */
+
+#define STRING_BUFFER_SIZE 256
+
+#define Is_high_surrogate(c) ((c) >= 0xD800 && (c) <= 0xDBFF)
+#define Is_low_surrogate(c) ((c) >= 0xDC00 && (c) <= 0xDFFF)
+
+static int all_ascii_utf16(const jchar * s)
+{
+  uint64_t w;
+  memcpy(&w, s, sizeof(w));
+  return (w & 0xFF80FF80FF80FF80ULL) == 0;
+}
+
+static int all_ascii_utf8(const char * s)
+{
+  uint64_t w;
+  memcpy(&w, s, sizeof(w));
+  return (w & 0x8080808080808080ULL) == 0;
+}
+
+static mlsize_t utf8_length_of_utf16(const jchar * s, jsize len)
+{
+  mlsize_t n = 0;
+  jsize i = 0;
+  jchar c;
+
+  while (i < len) {
+    if (i + 4 <= len && all_ascii_utf16(s + i)) { n += 4; i += 4; continue; }
+    c = s[i++];
+    if (c < 0x80) n += 1;
+    else if (c < 0x800) n += 2;
+    else if (Is_high_surrogate(c) && i < len && Is_low_surrogate(s[i])) {
+      n += 4; i++;
+    }
+    else n += 3;
+  }
+  return n;
+}
+
+static void utf16_to_utf8(const jchar * s, jsize len, unsigned char * d)
+{
+  jsize i = 0;
+  uint32_t c;
+
+  while (i < len) {
+    if (i + 4 <= len && all_ascii_utf16(s + i)) {
+      d[0] = s[i]; d[1] = s[i + 1]; d[2] = s[i + 2]; d[3] = s[i + 3];
+      d += 4; i += 4; continue;
+    }
+    c = s[i++];
+    if (c < 0x80) {
+      *d++ = c;
+    } else if (c < 0x800) {
+      *d++ = 0xC0 | (c >> 6);
+      *d++ = 0x80 | (c & 0x3F);
+    } else {
+      if (Is_high_surrogate(c) && i < len && Is_low_surrogate(s[i])) {
+        c = 0x10000 + ((c - 0xD800) << 10) + (s[i++] - 0xDC00);
+        *d++ = 0xF0 | (c >> 18);
+        *d++ = 0x80 | ((c >> 12) & 0x3F);
+      } else {
+        if (c >= 0xD800 && c <= 0xDFFF) c = 0xFFFD;
+        *d++ = 0xE0 | (c >> 12);
+      }
+      *d++ = 0x80 | ((c >> 6) & 0x3F);
+      *d++ = 0x80 | (c & 0x3F);
+    }
+  }
+}
+
+/* Decode one UTF-8 sequence starting at s[i]; return the code point
+   (U+FFFD if malformed) and advance *i. */
+static uint32_t utf8_decode(const unsigned char * s, mlsize_t len, mlsize_t * i)
+{
+  unsigned char c = s[*i];
+  uint32_t cp, min;
+  int n, k;
+
+  if (c < 0x80) { (*i)++; return c; }
+  else if (c >= 0xC2 && c <= 0xDF) { n = 1; cp = c & 0x1F; min = 0x80; }
+  else if (c >= 0xE0 && c <= 0xEF) { n = 2; cp = c & 0x0F; min = 0x800; }
+  else if (c >= 0xF0 && c <= 0xF4) { n = 3; cp = c & 0x07; min = 0x10000; }
+  else { (*i)++; return 0xFFFD; }
+  for (k = 1; k <= n; k++) {
+    if (*i + k >= len || (s[*i + k] & 0xC0) != 0x80) {
+      *i += k; return 0xFFFD;
+    }
+    cp = (cp << 6) | (s[*i + k] & 0x3F);
+  }
+  *i += n + 1;
+  if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    return 0xFFFD;
+  return cp;
+}
+
+/* The result has at most [len] UTF-16 units */
+static jsize utf8_to_utf16(const unsigned char * s, mlsize_t len, jchar * d)
+{
+  mlsize_t i = 0;
+  jsize n = 0;
+  uint32_t c;
+
+  while (i < len) {
+    if (i + 8 <= len && all_ascii_utf8((const char *) s + i)) {
+      int k;
+      for (k = 0; k < 8; k++) d[n + k] = s[i + k];
+      n += 8; i += 8; continue;
+    }
+    c = utf8_decode(s, len, &i);
+    if (c >= 0x10000) {
+      c -= 0x10000;
+      d[n++] = 0xD800 + (c >> 10);
+      d[n++] = 0xDC00 + (c & 0x3FF);
+    } else {
+      d[n++] = c;
+    }
+  }
+  return n;
+}
+
+static jstring make_java_string(JNIEnv * env, value vstr)
+{
+  jchar default_buf[STRING_BUFFER_SIZE];
+  jchar * buf;
+  mlsize_t len = caml_string_length(vstr);
+  jsize n;
+  jstring jstr;
+
+  if (len > (mlsize_t) 0x7FFFFFFF) caml_invalid_argument("Jni.string_to_java");
+  buf = len <= STRING_BUFFER_SIZE
+        ? default_buf : caml_stat_alloc(len * sizeof(jchar));
+  n = utf8_to_utf16((const unsigned char *) String_val(vstr), len, buf);
+  Stat_incr(STAT_STRING_CONVERSIONS);
+  Stat_add(STAT_STRING_BYTES, len);
+  jstr = (*env)->NewString(env, buf, n);
+  if (buf != default_buf) caml_stat_free(buf);
+  return jstr;
+}
+
 value camljava_MakeJavaString (value vstr)
 {
   jstring jstr;
   if (vstr == camljava_null_string)
     jstr = NULL;
   else {
-    jstr = (*jenv)->NewStringUTF(jenv, String_val(vstr));
+    jstr = make_java_string(jenv, vstr);
     if (jstr == NULL) check_java_exception();
   }
   return caml_alloc_jobject(jstr);
@@ -534,17 +2054,21 @@ value camljava_set_strconv(value v) {
 
 static value extract_java_string (JNIEnv * env, jstring jstr)
 {
+  jchar default_buf[STRING_BUFFER_SIZE];
+  jchar * buf;
   jsize len;
   value res;
-  jboolean isCopy;
-  const char * chrs;
 
   if (jstr == NULL) return camljava_null_string;
-  len = (*env)->GetStringUTFLength(env, jstr);
-  res = caml_alloc_string(len);
-  chrs = (*env)->GetStringUTFChars(env, jstr, &isCopy);
-  memcpy(&Byte(res, 0), chrs, len);
-  (*env)->ReleaseStringUTFChars(env, jstr, chrs);
+  len = (*env)->GetStringLength(env, jstr);
+  buf = len <= STRING_BUFFER_SIZE
+        ? default_buf : caml_stat_alloc(len * sizeof(jchar));
+  (*env)->GetStringRegion(env, jstr, 0, len, buf);
+  res = caml_alloc_string(utf8_length_of_utf16(buf, len));
+  utf16_to_utf8(buf, len, (unsigned char *) String_val(res));
+  if (buf != default_buf) caml_stat_free(buf);
+  Stat_incr(STAT_STRING_CONVERSIONS);
+  Stat_add(STAT_STRING_BYTES, caml_string_length(res));
   return res;
 }
 
@@ -558,6 +2082,70 @@ value camljava_ExtractJavaString (value vobj)
   return res;
 }
 
+/* Bulk conversions between Java String[] arrays and Caml string arrays.
+   Local references to the elements are deleted as the loop goes. */
+
+/* Set once by [init_class_refs] */
+static jclass string_class = NULL, string_array_class = NULL;
+
+value camljava_StringsOfJavaArray(value varray)
+{
+  JNIEnv * env = jenv;
+  jobjectArray arr;
+  jobject elt;
+  jsize n, i;
+  int checked;
+  value res = Val_unit, str = Val_unit;
+
+  check_non_null(varray);
+  arr = (jobjectArray) JObject(varray);
+  n = (*env)->GetArrayLength(env, arr);
+  if (n == 0) return Atom(0);
+  /* Elements of an Object[] array must be checked one by one */
+  checked = (*env)->IsInstanceOf(env, arr, string_array_class);
+  Begin_roots3(varray, res, str);
+    res = caml_alloc(n, 0);
+    for (i = 0; i < n; i++) {
+      elt = (*env)->GetObjectArrayElement(env, arr, i);
+      if (elt != NULL && !checked
+          && !(*env)->IsInstanceOf(env, elt, string_class)) {
+        (*env)->DeleteLocalRef(env, elt);
+        caml_invalid_argument("Jni.strings_of_java_array");
+      }
+      str = extract_java_string(env, (jstring) elt);
+      if (elt != NULL) (*env)->DeleteLocalRef(env, elt);
+      caml_modify(&Field(res, i), str);
+    }
+  End_roots();
+  return res;
+}
+
+value camljava_JavaArrayOfStrings(value vstrs)
+{
+  JNIEnv * env = jenv;
+  mlsize_t n = Wosize_val(vstrs), i;
+  jobjectArray arr;
+  jstring elt;
+  value v, res;
+
+  arr = (*env)->NewObjectArray(env, n, string_class, NULL);
+  if (arr == NULL) check_java_exception();
+  for (i = 0; i < n; i++) {
+    v = Field(vstrs, i);
+    if (v == camljava_null_string) continue;
+    elt = make_java_string(env, v);
+    if (elt == NULL) {
+      (*env)->DeleteLocalRef(env, arr);
+      check_java_exception();
+    }
+    (*env)->SetObjectArrayElement(env, arr, i, elt);
+    (*env)->DeleteLocalRef(env, elt);
+  }
+  res = caml_alloc_jobject_sized(arr, n * sizeof(jobject));
+  if (local_frame_depth == 0) (*env)->DeleteLocalRef(env, arr);
+  return res;
+}
+
 /******************** Arrays *******************/
 
 value camljava_GetArrayLength(value varray)
@@ -574,13 +2162,14 @@ value camljava_NewObjectArray(value vsize, value vclass)
     (*jenv)->NewObjectArray(jenv, Int_val(vsize), 
                            (jclass) JObject(vclass), NULL);
   if (arr == NULL) check_java_exception();
-  return caml_alloc_jobject(arr);
+  return caml_alloc_jobject_sized(arr, Int_val(vsize) * sizeof(jobject));
 }
 
 value camljava_GetObjectArrayElement(value varray, value vidx)
 {
   jobject res;
   check_non_null(varray);
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);
   res = (*jenv)->GetObjectArrayElement(jenv, (jobjectArray) JObject(varray),
                                        Int_val(vidx));
   check_java_exception();
@@ -590,6 +2179,7 @@ value camljava_GetObjectArrayElement(value varray, value vidx)
 value camljava_SetObjectArrayElement(value varray, value vidx, value vnewval)
 {
   check_non_null(varray);
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);
   (*jenv)->SetObjectArrayElement(jenv, (jobjectArray) JObject(varray),
                                 Int_val(vidx), JObject(vnewval));
   check_java_exception();
@@ -601,13 +2191,14 @@ value camljava_New##name##Array(value vsize)                                  \
 {                                                                             \
   array_typ arr = (*jenv)->New##name##Array(jenv, Int_val(vsize));            \
   if (arr == NULL) check_java_exception();                                    \
-  return caml_alloc_jobject(arr);                                                  \
+  return caml_alloc_jobject_sized(arr, Int_val(vsize) * sizeof(elt_typ));     \
 }                                                                             \
                                                                               \
 value camljava_Get##name##ArrayElement(value varray, value vidx)              \
 {                                                                             \
   elt_typ elt;                                                                \
   check_non_null(varray);                                                     \
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);                                     \
   (*jenv)->Get##name##ArrayRegion(jenv, (array_typ) JObject(varray),          \
                                   Int_val(vidx), 1, &elt);                    \
   check_java_exception();                                                     \
@@ -619,6 +2210,7 @@ value camljava_Set##name##ArrayElement(value varray, value vidx,              \
 {                                                                             \
   elt_typ elt;                                                                \
   check_non_null(varray);                                                     \
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);                                     \
   elt = from_value(vnewval);                                                  \
   (*jenv)->Set##name##ArrayRegion(jenv, (array_typ) JObject(varray),          \
                                   Int_val(vidx), 1, &elt);                    \
@@ -635,92 +2227,643 @@ ARRAYNEWGETSET(Long, jlongArray, jlong, Int64_val, caml_copy_int64)
 ARRAYNEWGETSET(Float, jfloatArray, jfloat, Double_val, caml_copy_double)
 ARRAYNEWGETSET(Double, jdoubleArray, jdouble, Double_val, caml_copy_double)
 
-value camljava_GetCamlintArrayElement(value varray, value vidx)
+value camljava_GetCamlintArrayElement(value varray, value vidx)
+{
+  jint elt;
+  check_non_null(varray);
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);
+  (*jenv)->GetIntArrayRegion(jenv, (jintArray) JObject(varray),
+                             Int_val(vidx), 1, &elt);
+  check_java_exception();
+  return Val_int(elt);
+}
+
+value camljava_SetCamlintArrayElement(value varray, value vidx,
+                                  value vnewval)
+{
+  jint elt = Int_val(vnewval);
+  check_non_null(varray);
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);
+  (*jenv)->SetIntArrayRegion(jenv, (jintArray) JObject(varray),
+                             Int_val(vidx), 1, &elt);
+  check_java_exception();
+  return Val_unit;
+}
+
+#define ARRAYGETSETUNBOXED(name,array_typ,elt_typ,nat_typ)                    \
+nat_typ camljava_Get##name##ArrayElement_unboxed(value varray, intnat idx)    \
+{                                                                             \
+  elt_typ elt;                                                                \
+  check_non_null(varray);                                                     \
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);                                     \
+  (*jenv)->Get##name##ArrayRegion(jenv, (array_typ) JObject(varray),          \
+                                  idx, 1, &elt);                              \
+  check_java_exception();                                                     \
+  return elt;                                                                 \
+}                                                                             \
+                                                                              \
+value camljava_Set##name##ArrayElement_unboxed(value varray, intnat idx,      \
+                                               nat_typ newval)                \
+{                                                                             \
+  elt_typ elt = newval;                                                       \
+  check_non_null(varray);                                                     \
+  Stat_incr(STAT_ARRAY_ELEMENT_ACCESSES);                                     \
+  (*jenv)->Set##name##ArrayRegion(jenv, (array_typ) JObject(varray),          \
+                                  idx, 1, &elt);                              \
+  check_java_exception();                                                     \
+  return Val_unit;                                                            \
+}
+
+ARRAYGETSETUNBOXED(Int, jintArray, jint, int32_t)
+ARRAYGETSETUNBOXED(Long, jlongArray, jlong, int64_t)
+ARRAYGETSETUNBOXED(Float, jfloatArray, jfloat, double)
+ARRAYGETSETUNBOXED(Double, jdoubleArray, jdouble, double)
+
+value camljava_GetByteArrayRegion(value varray, value vsrcidx,
+                                  value vstr, value vdstidx,
+                                  value vlength)
+{
+  long srcidx = Long_val(vsrcidx);
+  long dstidx = Long_val(vdstidx);
+  long length = Long_val(vlength);
+
+  check_non_null(varray);
+  if (dstidx < 0 || length < 0 || dstidx + length > caml_string_length(vstr))
+    caml_invalid_argument("Jni.get_byte_array_region");
+  Stat_region(length);
+  (*jenv)->GetByteArrayRegion(jenv, (jbyteArray) JObject(varray),
+                              srcidx, length, (jbyte *) &Byte(vstr, dstidx));
+  check_java_exception();
+  return Val_unit;
+}
+
+value camljava_SetByteArrayRegion(value vstr, value vsrcidx,
+                                  value varray, value vdstidx,
+                                  value vlength)
+{
+  long srcidx = Long_val(vsrcidx);
+  long dstidx = Long_val(vdstidx);
+  long length = Long_val(vlength);
+
+  check_non_null(varray);
+  if (srcidx < 0 || length < 0 || srcidx + length > caml_string_length(vstr))
+    caml_invalid_argument("Jni.set_byte_array_region");
+  Stat_region(length);
+  (*jenv)->SetByteArrayRegion(jenv, (jbyteArray) JObject(varray),
+                              dstidx, length, (jbyte *) &Byte(vstr, srcidx));
+  check_java_exception();
+  return Val_unit;
+}
+
+/* Bulk transfers between Java arrays of primitive type and Caml arrays.
+   Each transfer is a single Get/Set<Type>ArrayRegion into a temporary
+   buffer.  GCC vectorizes the conversion loops below only with
+   -ftree-vectorize, which -O2 does not imply before GCC 12 and enables
+   with a cost model too cheap for these loops: see VECTORIZE in
+   Makefile.config.  MSVC vectorizes them at /Ox. */
+
+#define NUM_DEFAULT_ELTS 256
+
+static mlsize_t float_array_length(value v)
+{
+  /* Empty arrays and non-flat float arrays are not accessed directly */
+  return Tag_val(v) == Double_array_tag ? Wosize_val(v) / Double_wosize : 0;
+}
+
+#define Int_array_length(v) Wosize_val(v)
+#define Int_array_get(v,i) Long_val(Field(v, i))
+#define Int_array_set(v,i,x) (Field(v, i) = Val_long(x))
+#define Bool_array_get(v,i) ((jboolean) Bool_val(Field(v, i)))
+#define Bool_array_set(v,i,x) (Field(v, i) = Val_jboolean(x))
+#define Float_array_get(v,i) (((double *) (v))[i])
+#define Float_array_set(v,i,x) (((double *) (v))[i] = (x))
+
+#define ARRAYREGION(name,jname,lname,array_typ,elt_typ,                     \
+                    ml_length,ml_get,ml_set)                                  \
+value camljava_Get##name##ArrayRegion(value varray, value vsrcidx,            \
+                                      value vdst, value vdstidx,              \
+                                      value vlength)                          \
+{                                                                             \
+  elt_typ default_buf[NUM_DEFAULT_ELTS];                                      \
+  elt_typ * buf;                                                              \
+  long srcidx = Long_val(vsrcidx);                                            \
+  long dstidx = Long_val(vdstidx);                                            \
+  long length = Long_val(vlength);                                            \
+  long i;                                                                     \
+                                                                              \
+  check_non_null(varray);                                                     \
+  if (dstidx < 0 || length < 0 || dstidx + length > ml_length(vdst))          \
+    caml_invalid_argument("Jni.get_" lname "_array_region");                  \
+  Stat_region(length * sizeof(elt_typ));                                      \
+  if (length <= NUM_DEFAULT_ELTS)                                             \
+    buf = default_buf;                                                        \
+  else                                                                        \
+    buf = caml_stat_alloc(length * sizeof(elt_typ));                          \
+  (*jenv)->Get##jname##ArrayRegion(jenv, (array_typ) JObject(varray),         \
+                                   srcidx, length, buf);                      \
+  if (! (*jenv)->ExceptionCheck(jenv))                                        \
+    for (i = 0; i < length; i++) ml_set(vdst, dstidx + i, buf[i]);            \
+  if (buf != default_buf) caml_stat_free(buf);                                \
+  check_java_exception();                                                     \
+  return Val_unit;                                                            \
+}                                                                             \
+                                                                              \
+value camljava_Set##name##ArrayRegion(value vsrc, value vsrcidx,              \
+                                      value varray, value vdstidx,            \
+                                      value vlength)                          \
+{                                                                             \
+  elt_typ default_buf[NUM_DEFAULT_ELTS];                                      \
+  elt_typ * buf;                                                              \
+  long srcidx = Long_val(vsrcidx);                                            \
+  long dstidx = Long_val(vdstidx);                                            \
+  long length = Long_val(vlength);                                            \
+  long i;                                                                     \
+                                                                              \
+  check_non_null(varray);                                                     \
+  if (srcidx < 0 || length < 0 || srcidx + length > ml_length(vsrc))          \
+    caml_invalid_argument("Jni.set_" lname "_array_region");                  \
+  Stat_region(length * sizeof(elt_typ));                                      \
+  if (length <= NUM_DEFAULT_ELTS)                                             \
+    buf = default_buf;                                                        \
+  else                                                                        \
+    buf = caml_stat_alloc(length * sizeof(elt_typ));                          \
+  for (i = 0; i < length; i++) buf[i] = ml_get(vsrc, srcidx + i);             \
+  (*jenv)->Set##jname##ArrayRegion(jenv, (array_typ) JObject(varray),         \
+                                   dstidx, length, buf);                      \
+  if (buf != default_buf) caml_stat_free(buf);                                \
+  check_java_exception();                                                     \
+  return Val_unit;                                                            \
+}
+
+ARRAYREGION(Boolean, Boolean, "boolean", jbooleanArray, jboolean,
+            Int_array_length, Bool_array_get, Bool_array_set)
+ARRAYREGION(Char, Char, "char", jcharArray, jchar,
+            Int_array_length, Int_array_get, Int_array_set)
+ARRAYREGION(Short, Short, "short", jshortArray, jshort,
+            Int_array_length, Int_array_get, Int_array_set)
+ARRAYREGION(Camlint, Int, "camlint", jintArray, jint,
+            Int_array_length, Int_array_get, Int_array_set)
+ARRAYREGION(Long, Long, "long", jlongArray, jlong,
+            Int_array_length, Int_array_get, Int_array_set)
+ARRAYREGION(Float, Float, "float", jfloatArray, jfloat,
+            float_array_length, Float_array_get, Float_array_set)
+
+/* Java double[] and Caml float arrays have the same representation:
+   copy directly, without going through a buffer. */
+
+value camljava_GetDoubleArrayRegion(value varray, value vsrcidx,
+                                    value vdst, value vdstidx,
+                                    value vlength)
 {
-  jint elt;
+  long srcidx = Long_val(vsrcidx);
+  long dstidx = Long_val(vdstidx);
+  long length = Long_val(vlength);
+
   check_non_null(varray);
-  (*jenv)->GetIntArrayRegion(jenv, (jintArray) JObject(varray),
-                             Int_val(vidx), 1, &elt);
+  if (dstidx < 0 || length < 0 || dstidx + length > float_array_length(vdst))
+    caml_invalid_argument("Jni.get_double_array_region");
+  Stat_region(length * sizeof(jdouble));
+  (*jenv)->GetDoubleArrayRegion(jenv, (jdoubleArray) JObject(varray),
+                                srcidx, length, (jdouble *) vdst + dstidx);
   check_java_exception();
-  return Val_int(elt);
+  return Val_unit;
 }
 
-value camljava_SetCamlintArrayElement(value varray, value vidx,
-                                  value vnewval)
+value camljava_SetDoubleArrayRegion(value vsrc, value vsrcidx,
+                                    value varray, value vdstidx,
+                                    value vlength)
 {
-  jint elt = Int_val(vnewval);
+  long srcidx = Long_val(vsrcidx);
+  long dstidx = Long_val(vdstidx);
+  long length = Long_val(vlength);
+
   check_non_null(varray);
-  (*jenv)->SetIntArrayRegion(jenv, (jintArray) JObject(varray),
-                             Int_val(vidx), 1, &elt);
+  if (srcidx < 0 || length < 0 || srcidx + length > float_array_length(vsrc))
+    caml_invalid_argument("Jni.set_double_array_region");
+  Stat_region(length * sizeof(jdouble));
+  (*jenv)->SetDoubleArrayRegion(jenv, (jdoubleArray) JObject(varray),
+                                dstidx, length, (jdouble *) vsrc + srcidx);
   check_java_exception();
   return Val_unit;
 }
 
-value camljava_GetByteArrayRegion(value varray, value vsrcidx,
-                                  value vstr, value vdstidx,
-                                  value vlength)
+/* The JNI has no region operations on object arrays: elements are
+   transferred one by one, but within a single crossing. */
+
+value camljava_GetObjectArrayRegion(value varray, value vsrcidx,
+                                    value vdst, value vdstidx,
+                                    value vlength)
 {
+  JNIEnv * env = jenv;
+  jobjectArray arr;
+  jobject elt;
   long srcidx = Long_val(vsrcidx);
   long dstidx = Long_val(vdstidx);
   long length = Long_val(vlength);
+  long i;
+  value v = Val_unit;
 
   check_non_null(varray);
-  if (dstidx < 0 || length < 0 || dstidx + length > caml_string_length(vstr))
-    caml_invalid_argument("Jni.get_byte_array_region");
-  (*jenv)->GetByteArrayRegion(jenv, (jbyteArray) JObject(varray),
-                              srcidx, length, (jbyte *) &Byte(vstr, dstidx));
-  check_java_exception();
+  if (dstidx < 0 || length < 0 || dstidx + length > Wosize_val(vdst))
+    caml_invalid_argument("Jni.get_object_array_region");
+  arr = (jobjectArray) JObject(varray);
+  Stat_region(length * sizeof(jobject));
+  Begin_roots2(vdst, v);
+    for (i = 0; i < length; i++) {
+      elt = (*env)->GetObjectArrayElement(env, arr, srcidx + i);
+      if (elt == NULL) check_java_exception();
+      v = caml_alloc_jobject(elt);
+      if (elt != NULL && local_frame_depth == 0)
+        (*env)->DeleteLocalRef(env, elt);
+      caml_modify(&Field(vdst, dstidx + i), v);
+    }
+  End_roots();
   return Val_unit;
 }
 
-value camljava_SetByteArrayRegion(value vstr, value vsrcidx,
-                                  value varray, value vdstidx,
-                                  value vlength)
+value camljava_SetObjectArrayRegion(value vsrc, value vsrcidx,
+                                    value varray, value vdstidx,
+                                    value vlength)
 {
+  JNIEnv * env = jenv;
+  jobjectArray arr;
   long srcidx = Long_val(vsrcidx);
   long dstidx = Long_val(vdstidx);
   long length = Long_val(vlength);
+  long i;
 
   check_non_null(varray);
-  if (srcidx < 0 || length < 0 || srcidx + length > caml_string_length(vstr))
-    caml_invalid_argument("Jni.set_byte_array_region");
-  (*jenv)->SetByteArrayRegion(jenv, (jbyteArray) JObject(varray),
-                              dstidx, length, (jbyte *) &Byte(vstr, srcidx));
+  if (srcidx < 0 || length < 0 || srcidx + length > Wosize_val(vsrc))
+    caml_invalid_argument("Jni.set_object_array_region");
+  arr = (jobjectArray) JObject(varray);
+  Stat_region(length * sizeof(jobject));
+  for (i = 0; i < length; i++) {
+    (*env)->SetObjectArrayElement(env, arr, dstidx + i,
+                                  JObject(Field(vsrc, srcidx + i)));
+    if ((*env)->ExceptionCheck(env)) break;
+  }
   check_java_exception();
   return Val_unit;
 }
 
+/******************** Direct buffers *******************/
+
+/* A bigarray viewing a Java buffer is a managed bigarray with a
+   proxy, which its sub-arrays, slices and reshapes share.  The proxy
+   is also referenced from [direct_buffers], with a global reference
+   to the buffer, so that the Caml GC never frees it: once only that
+   reference remains, the whole family of bigarrays is dead, and
+   [camljava_ReleaseDirectBuffers] deletes the global reference and
+   frees the proxy. */
+
+struct direct_buffer {
+  struct caml_ba_proxy * proxy;
+  jobject buf;                  /* global reference */
+  struct direct_buffer * next;
+};
+
+static struct direct_buffer * direct_buffers = NULL;
+
+#ifdef _WIN32
+static SRWLOCK direct_buffers_lock = SRWLOCK_INIT;
+#define Lock_direct_buffers() AcquireSRWLockExclusive(&direct_buffers_lock)
+#define Unlock_direct_buffers() ReleaseSRWLockExclusive(&direct_buffers_lock)
+#else
+static pthread_mutex_t direct_buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+#define Lock_direct_buffers() pthread_mutex_lock(&direct_buffers_lock)
+#define Unlock_direct_buffers() pthread_mutex_unlock(&direct_buffers_lock)
+#endif
+
+#if OCAML_VERSION_MAJOR >= 5 && !defined(_MSC_VER)
+#define Proxy_refcount(p) atomic_load(&(p)->refcount)
+#else
+#define Proxy_refcount(p) ((p)->refcount)
+#endif
+
+value camljava_GetDirectBufferAddress(value vkind, value vbuf)
+{
+  JNIEnv * env = jenv;
+  int kind = Int_val(vkind);
+  void * data;
+  jlong capacity;
+  jobject buf;
+  struct direct_buffer * d;
+  struct caml_ba_array * b;
+  value res;
+
+  check_non_null(vbuf);
+  data = (*env)->GetDirectBufferAddress(env, JObject(vbuf));
+  capacity = (*env)->GetDirectBufferCapacity(env, JObject(vbuf));
+  if (data == NULL || capacity < 0)
+    caml_invalid_argument("Jni.Direct.of_byte_buffer");
+  /* Taken before [vbuf] can be collected */
+  buf = (*env)->NewGlobalRef(env, JObject(vbuf));
+  if (buf == NULL) caml_raise_out_of_memory();
+  Counter_add(live_global_refs, 1);
+  /* External until the proxy is set: nothing to free if this raises */
+  res = caml_ba_alloc_dims(kind | CAML_BA_C_LAYOUT | CAML_BA_EXTERNAL, 1, data,
+                           (intnat) (capacity / caml_ba_element_size[kind]));
+  d = malloc(sizeof(struct direct_buffer));
+  if (d != NULL) d->proxy = malloc(sizeof(struct caml_ba_proxy));
+  if (d == NULL || d->proxy == NULL) {
+    free(d);
+    (*env)->DeleteGlobalRef(env, buf);
+    Counter_add(live_global_refs, -1);
+    caml_raise_out_of_memory();
+  }
+  /* One reference for the bigarray, one for [direct_buffers] */
+  d->proxy->refcount = 2;
+  d->proxy->data = data;
+  d->proxy->size = (uintnat) capacity;
+  d->buf = buf;
+  b = Caml_ba_array_val(res);
+  b->proxy = d->proxy;
+  b->flags = (b->flags & ~CAML_BA_MANAGED_MASK) | CAML_BA_MANAGED;
+  Lock_direct_buffers();
+  d->next = direct_buffers;
+  direct_buffers = d;
+  Unlock_direct_buffers();
+  return res;
+}
+
+/* Release the buffers of dead views.  Called from a GC alarm: does
+   nothing inside critical sections, and returns whether JNI calls are
+   allowed, i.e. whether the caller may release other Java objects. */
+
+value camljava_ReleaseDirectBuffers(value unit)
+{
+  JNIEnv * env = thread_jenv;
+  struct direct_buffer ** p, * d;
+
+  if (critical_depth > 0 || env == NULL) return Val_false;
+  Lock_direct_buffers();
+  p = &direct_buffers;
+  while ((d = *p) != NULL) {
+    if (Proxy_refcount(d->proxy) == 1) {
+      *p = d->next;
+      (*env)->DeleteGlobalRef(env, d->buf);
+      Counter_add(live_global_refs, -1);
+      free(d->proxy);
+      free(d);
+    } else {
+      p = &d->next;
+    }
+  }
+  Unlock_direct_buffers();
+  return Val_true;
+}
+
+value camljava_NewDirectByteBuffer(value vbigarray)
+{
+  struct caml_ba_array * b = Caml_ba_array_val(vbigarray);
+  jobject buf =
+    (*jenv)->NewDirectByteBuffer(jenv, b->data, caml_ba_byte_size(b));
+  if (buf == NULL) check_java_exception();
+  return caml_alloc_jobject(buf);
+}
+
+/************ Critical access to arrays of primitive type *************/
+
+/* Indexed by Bigarray kind */
+static const char * const critical_array_descr[] = {
+  "[F", "[D", "[B", "[Z", "[S", "[C", "[I", "[J"
+};
+static jclass critical_array_class[8];  /* set by init_class_refs */
+
+value camljava_GetPrimitiveArrayCritical(value vkind, value varray)
+{
+  int kind = Int_val(vkind);
+  jarray arr;
+  jsize len;
+  void * data;
+  value res;
+
+  check_non_null(varray);
+  arr = (jarray) JObject(varray);
+  if (kind < 0 || kind >= 8) caml_invalid_argument("Jni.with_critical_array");
+  if (! (*jenv)->IsInstanceOf(jenv, arr, critical_array_class[kind]))
+    caml_invalid_argument("Jni.with_critical_array");
+  len = (*jenv)->GetArrayLength(jenv, arr);
+  /* Allocate the bigarray before opening the section, which would
+     stay open if the allocation raised */
+  res = caml_ba_alloc_dims(kind | CAML_BA_C_LAYOUT | CAML_BA_EXTERNAL, 1,
+                           NULL, (intnat) 0);
+  data = (*jenv)->GetPrimitiveArrayCritical(jenv, arr, NULL);
+  if (data == NULL) {
+    check_java_exception();
+    caml_raise_out_of_memory();
+  }
+  critical_depth++;
+  Caml_ba_array_val(res)->data = data;
+  Caml_ba_array_val(res)->dim[0] = len;
+  return res;
+}
+
+value camljava_ReleasePrimitiveArrayCritical(value varray, value vbigarray,
+                                             value vcommit)
+{
+  struct caml_ba_array * b = Caml_ba_array_val(vbigarray);
+  /* The only JNI call allowed in the section: bypass [get_jenv] */
+  JNIEnv * env = thread_jenv;
+
+  (*env)->ReleasePrimitiveArrayCritical(env, (jarray) JObject(varray),
+                                        b->data,
+                                        Bool_val(vcommit) ? 0 : JNI_ABORT);
+  /* Make further accesses to the bigarray fail bound checks */
+  b->data = NULL;
+  b->dim[0] = 0;
+  critical_depth--;
+  if (critical_depth == 0) delete_deferred_refs();
+  return Val_unit;
+}
+
 /************************ Initialization *************************/
 
-value camljava_Init(value vclasspath)
+/* Set when this code is loaded into a running JVM as a JNI library
+   (System.loadLibrary).  Define CAMLJAVA_NO_ONLOAD if the program
+   provides its own JNI_OnLoad. */
+
+#ifndef CAMLJAVA_NO_ONLOAD
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM * vm, void * reserved)
+{
+  jvm = vm;
+  return JNI_VERSION_1_2;
+}
+#endif
+
+static int register_natives(JNIEnv * env);
+static int init_caml_classes(JNIEnv * env);
+
+/* The functions below run with the start-up lock held.  They do not
+   raise: they return -1, or NULL, when a Java exception is pending,
+   and [init_jvm] raises it once the lock is released. */
+
+static jclass global_class(JNIEnv * env, const char * name)
+{
+  jclass c = (*env)->FindClass(env, name), g;
+  if (c == NULL) return NULL;
+  g = (*env)->NewGlobalRef(env, c);
+  (*env)->DeleteLocalRef(env, c);
+  return g;
+}
+
+/* The classes and method IDs used by the stubs are looked up here,
+   once, before any other thread can use the JVM through this code,
+   rather than lazily in the stubs that use them. */
+
+static int init_class_refs(JNIEnv * env)
+{
+  unsigned int i;
+  jclass c;
+
+  system_class = global_class(env, "java/lang/System");
+  if (system_class == NULL) return -1;
+  identity_hash_code =
+    (*env)->GetStaticMethodID(env, system_class, "identityHashCode",
+                              "(Ljava/lang/Object;)I");
+  if (identity_hash_code == NULL) return -1;
+  string_class = global_class(env, "java/lang/String");
+  if (string_class == NULL) return -1;
+  string_array_class = global_class(env, "[Ljava/lang/String;");
+  if (string_array_class == NULL) return -1;
+  for (i = 0; i < 8; i++) {
+    critical_array_class[i] = global_class(env, critical_array_descr[i]);
+    if (critical_array_class[i] == NULL) return -1;
+  }
+  for (i = 0; i < NUM_MAPPED_EXCEPTIONS; i++) {
+    c = (*env)->FindClass(env, mapped_exceptions[i].class_name);
+    if (c == NULL) { (*env)->ExceptionClear(env); continue; }
+    mapped_exceptions[i].cls = (*env)->NewGlobalRef(env, c);
+    (*env)->DeleteLocalRef(env, c);
+  }
+  return init_caml_classes(env);
+}
+
+/* Use the JVM this code was loaded into, or any JVM already created
+   in the process; otherwise, create one with the class path
+   [jclasspath] and the additional JVM options [joptions], e.g. "-Xmx1g"
+   or "-XX:SharedArchiveFile=camljava.jsa".  Only a JVM created here is
+   destroyed by [camljava_Shutdown]. */
+
+static int start_jvm_locked(const char * jclasspath,
+                            char * const * joptions, mlsize_t nopts)
 {
   JavaVMInitArgs vm_args;
-  JavaVMOption options[1];
+  JavaVMOption * options;
   int retcode;
+  jsize nvms;
+  mlsize_t i;
   char * classpath;
   char * setclasspath = "-Djava.class.path=";
+  char * preload;
+
+  if (jvm == NULL
+      && (JNI_GetCreatedJavaVMs(&jvm, 1, &nvms) != JNI_OK || nvms == 0))
+    jvm = NULL;
+  if (jvm != NULL) {
+    init_threading();
+    attach_current_thread();
+  } else {
+    options = caml_stat_alloc_noexc((nopts + 1) * sizeof(JavaVMOption));
+    /* Set the class path */
+    classpath = caml_stat_alloc_noexc(strlen(setclasspath)
+                                      + strlen(jclasspath) + 1);
+    if (options == NULL || classpath == NULL) {
+      caml_stat_free(options); caml_stat_free(classpath);
+      return -2;
+    }
+    strcpy(classpath, setclasspath);
+    strcat(classpath, jclasspath);
+    options[0].optionString = classpath;
+    options[0].extraInfo = NULL;
+    for (i = 0; i < nopts; i++) {
+      options[i + 1].optionString = joptions[i];
+      options[i + 1].extraInfo = NULL;
+    }
+    vm_args.version = JNI_VERSION_1_2;
+    vm_args.options = options;
+    vm_args.nOptions = nopts + 1;
+    vm_args.ignoreUnrecognized = 1;
+    /* Load and initialize a Java VM, return a JNI interface pointer in env */
+    retcode = JNI_CreateJavaVM(&jvm, (void **) &thread_jenv, &vm_args);
+    caml_stat_free(classpath);
+    caml_stat_free(options);
+    if (retcode < 0) { jvm = NULL; return -3; }
+    jvm_owned = 1;
+    init_threading();
+  }
+  if (register_natives(thread_jenv) == -1
+      || init_class_refs(thread_jenv) == -1)
+    return -1;
+  preload = getenv("CAMLJAVA_PRELOAD");
+  if (preload != NULL) preload_classes(thread_jenv, preload);
+  return 0;
+}
+
+static void init_jvm(const char * jclasspath,
+                     char * const * joptions, mlsize_t nopts)
+{
+  int rc = 0;
+
+  if (Jvm_initialized()) return;
+  Lock_jvm_start();
+  if (! Jvm_initialized()) {
+    rc = start_jvm_locked(jclasspath, joptions, nopts);
+    if (rc == 0) Set_jvm_initialized();
+  }
+  Unlock_jvm_start();
+  switch (rc) {
+  case 0:
+    return;
+  case -1:
+    /* A Java exception is pending.  It can only be mapped to a Caml
+       exception if the class references are set. */
+    if (identity_hash_code != NULL) check_java_exception();
+    (*thread_jenv)->ExceptionClear(thread_jenv);
+    caml_failwith("Java.init");
+  case -2:
+    caml_raise_out_of_memory();
+  default:
+    caml_failwith("Java.init");
+  }
+}
+
+value camljava_Init(value vclasspath, value voptions)
+{
+  mlsize_t nopts = Wosize_val(voptions), i;
+  char ** options;
+
+  if (Jvm_initialized()) return Val_unit;
+  options = caml_stat_alloc((nopts + 1) * sizeof(char *));
+  for (i = 0; i < nopts; i++)
+    options[i] = (char *) String_val(Field(voptions, i));
+  init_jvm(String_val(vclasspath), options, nopts);
+  caml_stat_free(options);
+  return Val_unit;
+}
 
-  /* Set the class path */
-  classpath = 
-    caml_stat_alloc(strlen(setclasspath) + caml_string_length(vclasspath) + 1);
-  strcpy(classpath, setclasspath);
-  strcat(classpath, String_val(vclasspath));
-  options[0].optionString = classpath;
-  vm_args.version = JNI_VERSION_1_2;
-  vm_args.options = options;
-  vm_args.nOptions = 1;
-  vm_args.ignoreUnrecognized = 1;
-  /* Load and initialize a Java VM, return a JNI interface pointer in env */
-  retcode = JNI_CreateJavaVM(&jvm, (void **) &jenv, &vm_args);
-  caml_stat_free(classpath);
-  if (retcode < 0) caml_failwith("Java.init");
-  init_threading(); // by O'Jacare
+/* Called when the Jni module is initialized, with the class path and
+   the options to use if the JVM is started on first use. */
+
+value camljava_SetDefaultVMArgs(value vclasspath, value voptions)
+{
+  mlsize_t nopts = Wosize_val(voptions), i;
+
+  if (default_classpath != NULL) return Val_unit;
+  default_options = caml_stat_alloc((nopts + 1) * sizeof(char *));
+  for (i = 0; i < nopts; i++)
+    default_options[i] = caml_stat_strdup(String_val(Field(voptions, i)));
+  default_nopts = nopts;
+  default_classpath = caml_stat_strdup(String_val(vclasspath));
   return Val_unit;
 }
 
 value camljava_Shutdown(value unit)
 {
-  (*jvm)->DestroyJavaVM(jvm);
+  if (jvm_owned) {
+    jvm_owned = 0;
+    (*jvm)->DestroyJavaVM(jvm);
+  }
   return Val_unit;
 }
 
@@ -755,6 +2898,80 @@ value camljava_IsSameObject(value vobj1, value vobj2)
                                             JObject(vobj2)));
 }
 
+value camljava_IdentityHash(value vobj)
+{
+  return Val_long(Handle_hash(check_handle(vobj)) & 0x3FFFFFFF);
+}
+
+/* Weak global references, for Jni.WeakObjTbl.  They do not keep their
+   object alive; [camljava_WeakGet] returns [null] once it has been
+   collected. */
+
+#define JWeak(v) (*((jweak *) Data_custom_val(v)))
+
+static void finalize_jweak(value v)
+{
+  jweak w = JWeak(v);
+  if (w == NULL) return;
+  if (critical_depth > 0)
+    defer_delete_global_ref(w, 1);
+  else
+    (*jenv)->DeleteWeakGlobalRef(jenv, w);
+}
+
+static struct custom_operations jweak_ops = {
+  "java.lang.Object/weak",
+  finalize_jweak,
+  custom_compare_default,
+  custom_hash_default,
+  custom_serialize_default,
+  custom_deserialize_default
+};
+
+value camljava_NewWeakRef(value vobj)
+{
+  value v;
+  jobject obj;
+  jweak w = NULL;
+
+  check_not_critical();
+  obj = JObject(vobj);          /* before [vobj] can move */
+  v = caml_alloc_custom(&jweak_ops, sizeof(jweak), 0, 1);
+  JWeak(v) = NULL;
+  if (obj != NULL) {
+    w = (*jenv)->NewWeakGlobalRef(jenv, obj);
+    if (w == NULL) caml_raise_out_of_memory();
+  }
+  JWeak(v) = w;
+  return v;
+}
+
+value camljava_WeakGet(value vweak)
+{
+  jobject obj;
+  value res;
+
+  check_not_critical();
+  if (JWeak(vweak) == NULL) return caml_alloc_jobject(NULL);
+  obj = (*jenv)->NewLocalRef(jenv, JWeak(vweak));
+  res = caml_alloc_jobject(obj);
+  if (obj != NULL && local_frame_depth == 0)
+    (*jenv)->DeleteLocalRef(jenv, obj);
+  return res;
+}
+
+value camljava_WeakIs(value vweak, value vobj)
+{
+  if (JObject(vobj) == NULL) return Val_false;
+  return Val_jboolean((*jenv)->IsSameObject(jenv, JWeak(vweak),
+                                            JObject(vobj)));
+}
+
+value camljava_WeakCleared(value vweak)
+{
+  return Val_jboolean((*jenv)->IsSameObject(jenv, JWeak(vweak), NULL));
+}
+
 /********************* Callback from Java to Caml ******************/
 
 static jclass caml_boolean, caml_byte, caml_char, caml_short, caml_int,
@@ -764,7 +2981,6 @@ static jfieldID caml_boolean_contents, caml_byte_contents,
   caml_char_contents, caml_short_contents, caml_int_contents,
   caml_camlint_contents, caml_long_contents,
   caml_float_contents, caml_double_contents;
-static int caml_classes_initialized = 0;
 
 static int init_caml_classes(JNIEnv * env)
 {
@@ -808,38 +3024,173 @@ static int init_caml_classes(JNIEnv * env)
 #undef INIT_CAML_CLASS
 }
 
-#define CALLBACK_OUT_OF_MEMORY Make_exception_result(0)
+/* Returned by the callback functions when a Java exception is pending */
+#define CALLBACK_JAVA_EXCEPTION Make_exception_result(0)
+
+/* Root slots.  Wrapped Caml objects and the closures of bound callbacks
+   are kept in slots of slabs: Caml arrays of SLAB_SIZE values, each
+   registered as a single generational global root.  Free slots are
+   chained through the arrays themselves, as Caml integers.  A wrapped
+   object is identified by its slot number. */
+
+#define SLAB_SIZE 1024
+#define MAX_SLABS 65536
+
+struct camljava_bound;
+
+struct slab {
+  value roots;                  /* generational global root */
+  struct camljava_bound * bounds[SLAB_SIZE]; /* bound callbacks of wrappers */
+};
+
+static struct slab * slabs[MAX_SLABS];
+static intnat num_slabs = 0;
+static intnat slot_free_list = -1;
+
+#ifdef _WIN32
+static SRWLOCK slots_lock = SRWLOCK_INIT;
+#define Lock_slots() AcquireSRWLockExclusive(&slots_lock)
+#define Unlock_slots() ReleaseSRWLockExclusive(&slots_lock)
+#else
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+#define Lock_slots() pthread_mutex_lock(&slots_lock)
+#define Unlock_slots() pthread_mutex_unlock(&slots_lock)
+#endif
+
+#define Slot(s) Field(slabs[(s) / SLAB_SIZE]->roots, (s) % SLAB_SIZE)
+#define Slot_bounds(s) (slabs[(s) / SLAB_SIZE]->bounds[(s) % SLAB_SIZE])
+
+static void add_slab(void)
+{
+  struct slab * sl;
+  intnat i, base;
+
+  if (num_slabs >= MAX_SLABS) caml_raise_out_of_memory();
+  sl = caml_stat_alloc(sizeof(struct slab));
+  sl->roots = caml_alloc(SLAB_SIZE, 0);
+  caml_register_generational_global_root(&sl->roots);
+  memset(sl->bounds, 0, sizeof(sl->bounds));
+  Lock_slots();
+  base = num_slabs * SLAB_SIZE;
+  for (i = SLAB_SIZE - 1; i >= 0; i--) {
+    Field(sl->roots, i) = Val_long(slot_free_list);
+    slot_free_list = base + i;
+  }
+  slabs[num_slabs++] = sl;
+  Unlock_slots();
+}
+
+static intnat alloc_slot(value v)
+{
+  intnat s;
+  Begin_root(v);
+    while (1) {
+      Lock_slots();
+      s = slot_free_list;
+      if (s >= 0) {
+        slot_free_list = Long_val(Slot(s));
+        caml_modify(&Slot(s), v);
+        Slot_bounds(s) = NULL;
+        Counter_add(live_root_slots, 1);
+        Unlock_slots();
+        break;
+      }
+      Unlock_slots();
+      add_slab();
+    }
+  End_roots();
+  return s;
+}
+
+/* Must be called with the slots locked */
+static void release_slot(intnat s)
+{
+  caml_modify(&Slot(s), Val_long(slot_free_list));
+  slot_free_list = s;
+  Counter_add(live_root_slots, -1);
+}
+
+/* Bound callbacks resolve one method of a wrapped object once and for
+   all.  They are invalidated when the wrapper is released. */
+
+struct camljava_bound {
+  intnat closure;               /* slot of the method closure */
+  intnat wrapper;               /* slot of the object, or BOUND_INVALID_* */
+  struct camljava_bound * next;
+};
+
+#define BOUND_INVALID_WRAPPER (-1)  /* the wrapped object was released */
+#define BOUND_INVALID_RELEASED (-2) /* BoundCallback.release() */
+
+/* Bound callbacks are invoked through the same natives as the methods
+   of wrapped objects, with BOUND_METHOD as method ID.  Method IDs are
+   hashes of method labels, which are never 0. */
+#define BOUND_METHOD 0
+
+#define Bound_val(l) ((struct camljava_bound *) (value) (l))
+
+/* Return the Caml object receiving the callback, or 0 if it was
+   released (a Java exception is then pending). */
+static value callback_self(JNIEnv * env, jlong obj_proxy, jlong method_id)
+{
+  if (method_id == BOUND_METHOD) {
+    if (obj_proxy == 0 || Bound_val(obj_proxy)->wrapper < 0) {
+      (*env)->ThrowNew(env,
+                       (*env)->FindClass(env, "java/lang/IllegalStateException"),
+                       obj_proxy == 0
+                       || Bound_val(obj_proxy)->wrapper == BOUND_INVALID_RELEASED
+                       ? "BoundCallback was released"
+                       : "Caml object was released");
+      return 0;
+    }
+    return Slot(Bound_val(obj_proxy)->wrapper);
+  }
+  return Slot(obj_proxy);
+}
+
+static value callback_closure(jlong obj_proxy, jlong method_id, value self)
+{
+  if (method_id == BOUND_METHOD) return Slot(Bound_val(obj_proxy)->closure);
+  return caml_get_public_method(self, (value) method_id);
+}
 
 static value camljava_callback(JNIEnv * env,
                                jlong obj_proxy,
                                jlong method_id,
                                jobjectArray jargs)
 {
-  JNIEnv * savedenv;
-  int n, i;
+  int n, i, saved_frame_depth;
+  value default_cargs[NUM_DEFAULT_ARGS + 1];
   value * cargs;
   jobject arg;
   value carg, clos, res;
 
-  savedenv = jenv;
-  jenv = env;
+  camljava_check_caml_thread(env);
 
-  camljava_check_main_thread(); // by O'Jacare
-
-  if (!caml_classes_initialized) {
-    if (init_caml_classes(env) == -1) return -1;
-    caml_classes_initialized = 1;
+  if (callback_self(env, obj_proxy, method_id) == 0)
+    return CALLBACK_JAVA_EXCEPTION;
+  if (jargs == NULL) {
+    (*env)->ThrowNew(env,
+                     (*env)->FindClass(env, "java/lang/NullPointerException"),
+                     "null argument array in Java->Caml callback");
+    return CALLBACK_JAVA_EXCEPTION;
   }
+  Stat_incr(STAT_CALLBACKS);
   n = 1 + (*env)->GetArrayLength(env, jargs);
-  cargs = malloc(n * sizeof(value));
+  if (n <= NUM_DEFAULT_ARGS + 1)
+    cargs = default_cargs;
+  else
+    cargs = malloc(n * sizeof(value));
   if (cargs == NULL) {
     (*env)->ThrowNew(env,
                      (*env)->FindClass(env, "java/lang/OutOfMemoryError"),
                      "Out of memory in Java->Caml callback");
-    jenv = savedenv;
-    return CALLBACK_OUT_OF_MEMORY;
+    return CALLBACK_JAVA_EXCEPTION;
   }
-  cargs[0] = *((value *) ((value) obj_proxy));
+  /* Objects created by the callback must outlive its JNI frame */
+  saved_frame_depth = local_frame_depth;
+  local_frame_depth = 0;
+  cargs[0] = callback_self(env, obj_proxy, method_id);
   for (i = 1; i < n; i++) cargs[i] = Val_unit;
   Begin_roots_block(cargs, n)
     for (i = 1; i < n; i++) {
@@ -876,10 +3227,12 @@ static value camljava_callback(JNIEnv * env,
       cargs[i] = carg;
     }
   End_roots();
-  clos = caml_get_public_method(cargs[0], (value) method_id);
+  clos = callback_closure(obj_proxy, method_id, cargs[0]);
+  callback_depth++;
   res = caml_callbackN_exn(clos, n, cargs);
-  free(cargs);
-  jenv = savedenv;
+  callback_depth--;
+  local_frame_depth = saved_frame_depth;
+  if (cargs != default_cargs) free(cargs);
   return res;
 }
 
@@ -887,17 +3240,42 @@ static void map_caml_exception(JNIEnv * env, value exn)
 {
   value name;
 
+  if ((*env)->ExceptionCheck(env)) return; /* already a Java exception */
   exn = Extract_exception(exn);
   name = Field(Field(exn, 0), 0);
+  Stat_incr(STAT_EXCEPTIONS_THROWN);
   (*env)->ThrowNew(env, caml_exception, String_val(name));
 }
 
+/* A callback that arrives during a blocking method call must reacquire
+   the Caml runtime, and release it again before returning to Java. */
+
+static int callback_enter(void)
+{
+  int blocking = in_blocking_call;
+  if (blocking) {
+    in_blocking_call = 0;
+    caml_leave_blocking_section();
+  }
+  return blocking;
+}
+
+static void callback_leave(int blocking)
+{
+  if (blocking) {
+    caml_enter_blocking_section();
+    in_blocking_call = 1;
+  }
+}
+
 void camljava_CallbackVoid(JNIEnv * env, jclass cls,
                            jlong obj_proxy, jlong method_id,
                            jobjectArray args)
 {
+  int blocking = callback_enter();
   value res = camljava_callback(env, obj_proxy, method_id, args);
   if (Is_exception_result(res)) map_caml_exception(env, res);
+  callback_leave(blocking);
 }
 
 #define CALLBACK(name,restyp,conv)                                          \
@@ -905,14 +3283,22 @@ restyp camljava_Callback##name(JNIEnv * env, jclass cls,                    \
                                 jlong obj_proxy, jlong method_id,           \
                                 jobjectArray args)                          \
 {                                                                           \
+  int blocking = callback_enter();                                          \
   value res = camljava_callback(env, obj_proxy, method_id, args);           \
+  restyp r;                                                                 \
   if (Is_exception_result(res)) {                                           \
     map_caml_exception(env, res);                                           \
-    return 0; /*dummy return value*/                                        \
+    r = 0; /*dummy return value*/                                           \
   } else                                                                    \
-    return conv(res);                                                       \
+    r = conv(res);                                                          \
+  callback_leave(blocking);                                                 \
+  return r;                                                                 \
 }
 
+/* The global reference owned by the Caml result can be released as soon
+   as other Caml code runs: return a local reference to Java instead. */
+#define JObject_local(v) ((*env)->NewLocalRef(env, JObject(v)))
+
 CALLBACK(Boolean, jboolean, Jboolean_val)
 CALLBACK(Byte, jbyte, Int_val)
 CALLBACK(Char, jchar, Int_val)
@@ -922,23 +3308,295 @@ CALLBACK(Int, jint, Int32_val)
 CALLBACK(Long, jlong, Int64_val)
 CALLBACK(Float, jfloat, Double_val)
 CALLBACK(Double, jdouble, Double_val)
-CALLBACK(Object, jobject, JObject)
+CALLBACK(Object, jobject, JObject_local)
+
+/* Typed callbacks: Callback.callXXXn(methid, a1, ..., an) with 0 to 3
+   arguments of the same primitive or Object type pass their arguments
+   directly, without wrapper objects or argument array.  Java int
+   arguments become Caml int, long become int64, double become float. */
+
+#define MAX_TYPED_ARGS 3
+
+static value camljava_typed_callback(JNIEnv * env,
+                                     jlong obj_proxy,
+                                     jlong method_id,
+                                     int nargs, int kind, jvalue * args)
+{
+  int n = nargs + 1, i, saved_frame_depth;
+  value cargs[MAX_TYPED_ARGS + 1];
+  value clos, res;
+
+  camljava_check_caml_thread(env);
+
+  if (callback_self(env, obj_proxy, method_id) == 0)
+    return CALLBACK_JAVA_EXCEPTION;
+  Stat_incr(STAT_CALLBACKS);
+  saved_frame_depth = local_frame_depth;
+  local_frame_depth = 0;
+  cargs[0] = callback_self(env, obj_proxy, method_id);
+  for (i = 1; i < n; i++) cargs[i] = Val_unit;
+  Begin_roots_block(cargs, n)
+    for (i = 1; i < n; i++) {
+      switch (kind) {
+      case 'I':
+        cargs[i] = Val_int(args[i - 1].i); break;
+      case 'J':
+        cargs[i] = caml_copy_int64(args[i - 1].j); break;
+      case 'D':
+        cargs[i] = caml_copy_double(args[i - 1].d); break;
+      default:
+        if (args[i - 1].l != NULL && string_auto_conv
+            && (*env)->IsInstanceOf(env, args[i - 1].l, java_lang_string))
+          cargs[i] = extract_java_string(env, (jstring) args[i - 1].l);
+        else
+          cargs[i] = caml_alloc_jobject(args[i - 1].l);
+        break;
+      }
+    }
+    clos = callback_closure(obj_proxy, method_id, cargs[0]);
+    callback_depth++;
+    res = caml_callbackN_exn(clos, n, cargs);
+    callback_depth--;
+  End_roots();
+  local_frame_depth = saved_frame_depth;
+  return res;
+}
+
+static void typed_callback_Void(JNIEnv * env, jlong obj_proxy,
+                                jlong method_id,
+                                int nargs, int kind, jvalue * args)
+{
+  int blocking = callback_enter();
+  value res = camljava_typed_callback(env, obj_proxy, method_id,
+                                      nargs, kind, args);
+  if (Is_exception_result(res)) map_caml_exception(env, res);
+  callback_leave(blocking);
+}
+
+#define TYPEDCALLBACK(name,restyp,conv)                                     \
+static restyp typed_callback_##name(JNIEnv * env, jlong obj_proxy,          \
+                                    jlong method_id,                        \
+                                    int nargs, int kind, jvalue * args)     \
+{                                                                           \
+  int blocking = callback_enter();                                          \
+  value res = camljava_typed_callback(env, obj_proxy, method_id,            \
+                                      nargs, kind, args);                   \
+  restyp r;                                                                 \
+  if (Is_exception_result(res)) {                                           \
+    map_caml_exception(env, res);                                           \
+    r = 0; /*dummy return value*/                                           \
+  } else                                                                    \
+    r = conv(res);                                                          \
+  callback_leave(blocking);                                                 \
+  return r;                                                                 \
+}
+
+TYPEDCALLBACK(Boolean, jboolean, Jboolean_val)
+TYPEDCALLBACK(Camlint, jint, Int_val)
+TYPEDCALLBACK(Int, jint, Int32_val)
+TYPEDCALLBACK(Long, jlong, Int64_val)
+TYPEDCALLBACK(Double, jdouble, Double_val)
+TYPEDCALLBACK(Object, jobject, JObject_local)
+
+#define Cb_arg_O jobject
+#define Cb_arg_I jint
+#define Cb_arg_J jlong
+#define Cb_arg_D jdouble
+
+#define Cb_set_O(jv,x) ((jv).l = (x))
+#define Cb_set_I(jv,x) ((jv).i = (x))
+#define Cb_set_J(jv,x) ((jv).j = (x))
+#define Cb_set_D(jv,x) ((jv).d = (x))
+
+#define Cb_sig_O "Ljava/lang/Object;"
+#define Cb_sig_I "I"
+#define Cb_sig_J "J"
+#define Cb_sig_D "D"
+
+/* [ret] is [return], or nothing for void callbacks */
+#define TYPEDCALLBACK0(name,restyp,ret)                                     \
+restyp camljava_Callback##name##0(JNIEnv * env, jclass cls,                 \
+                                  jlong obj_proxy, jlong method_id)         \
+{                                                                           \
+  ret typed_callback_##name(env, obj_proxy, method_id, 0, 'O', NULL);       \
+}
+
+#define TYPEDCALLBACK1(name,restyp,ret,K)                                   \
+restyp camljava_Callback##name##1##K(JNIEnv * env, jclass cls,              \
+                                     jlong obj_proxy, jlong method_id,      \
+                                     Cb_arg_##K a1)                         \
+{                                                                           \
+  jvalue args[1];                                                           \
+  Cb_set_##K(args[0], a1);                                                  \
+  ret typed_callback_##name(env, obj_proxy, method_id, 1, #K[0], args);     \
+}
+
+#define TYPEDCALLBACK2(name,restyp,ret,K)                                   \
+restyp camljava_Callback##name##2##K(JNIEnv * env, jclass cls,              \
+                                     jlong obj_proxy, jlong method_id,      \
+                                     Cb_arg_##K a1, Cb_arg_##K a2)          \
+{                                                                           \
+  jvalue args[2];                                                           \
+  Cb_set_##K(args[0], a1); Cb_set_##K(args[1], a2);                         \
+  ret typed_callback_##name(env, obj_proxy, method_id, 2, #K[0], args);     \
+}
+
+#define TYPEDCALLBACK3(name,restyp,ret,K)                                   \
+restyp camljava_Callback##name##3##K(JNIEnv * env, jclass cls,              \
+                                     jlong obj_proxy, jlong method_id,      \
+                                     Cb_arg_##K a1, Cb_arg_##K a2,          \
+                                     Cb_arg_##K a3)                         \
+{                                                                           \
+  jvalue args[3];                                                           \
+  Cb_set_##K(args[0], a1); Cb_set_##K(args[1], a2);                         \
+  Cb_set_##K(args[2], a3);                                                  \
+  ret typed_callback_##name(env, obj_proxy, method_id, 3, #K[0], args);     \
+}
+
+#define TYPEDCALLBACKKIND(name,restyp,ret,K)                                \
+  TYPEDCALLBACK1(name,restyp,ret,K)                                         \
+  TYPEDCALLBACK2(name,restyp,ret,K)                                         \
+  TYPEDCALLBACK3(name,restyp,ret,K)
+
+#define TYPEDCALLBACKS(name,restyp,ret)                                     \
+  TYPEDCALLBACK0(name,restyp,ret)                                           \
+  TYPEDCALLBACKKIND(name,restyp,ret,O)                                      \
+  TYPEDCALLBACKKIND(name,restyp,ret,I)                                      \
+  TYPEDCALLBACKKIND(name,restyp,ret,J)                                      \
+  TYPEDCALLBACKKIND(name,restyp,ret,D)
+
+TYPEDCALLBACKS(Void, void, )
+TYPEDCALLBACKS(Boolean, jboolean, return)
+TYPEDCALLBACKS(Camlint, jint, return)
+TYPEDCALLBACKS(Int, jint, return)
+TYPEDCALLBACKS(Long, jlong, return)
+TYPEDCALLBACKS(Double, jdouble, return)
+TYPEDCALLBACKS(Object, jobject, return)
 
 /****************** Auxiliary functions for callbacks *****************/
 
+/* Java releases wrappers and bound callbacks (through a Cleaner) by
+   queueing them and calling notifyReleased.  The queue is drained in
+   batches when new objects are wrapped, and by Jni.release_callbacks.
+   See Callback.java for the encoding of the queued handles.  A bound
+   callback is freed only once its BoundCallback is unreachable:
+   BoundCallback.release() merely invalidates it, since a call in
+   progress in another thread may have read it before the release. */
+
+#define RELEASE_BATCH 256
+
+static volatile int callbacks_released = 0;
+
+void camljava_NotifyReleased(JNIEnv * env, jclass cls)
+{
+  callbacks_released = 1;
+}
+
+static void release_wrapper(intnat w)
+{
+  struct camljava_bound * b;
+  for (b = Slot_bounds(w); b != NULL; b = b->next) {
+    release_slot(b->closure);
+    b->wrapper = BOUND_INVALID_WRAPPER;
+  }
+  Slot_bounds(w) = NULL;
+  release_slot(w);
+}
+
+static void invalidate_bound(struct camljava_bound * b)
+{
+  struct camljava_bound ** p;
+  if (b->wrapper >= 0) {
+    for (p = &Slot_bounds(b->wrapper); *p != b; p = &(*p)->next) /*nothing*/;
+    *p = b->next;
+    release_slot(b->closure);
+    b->wrapper = BOUND_INVALID_RELEASED;
+  }
+}
+
+static void release_callbacks(void)
+{
+  JNIEnv * env = jenv;
+  jclass cls;
+  jmethodID drain;
+  jlongArray jbuf;
+  jlong buf[RELEASE_BATCH];
+  jint n, i;
+
+  callbacks_released = 0;
+  check_not_critical();
+  cls = (*env)->FindClass(env, "fr/inria/caml/camljava/Callback");
+  if (cls == NULL) check_java_exception();
+  drain = (*env)->GetStaticMethodID(env, cls, "drainReleased", "([J)I");
+  if (drain == NULL) check_java_exception();
+  jbuf = (*env)->NewLongArray(env, RELEASE_BATCH);
+  if (jbuf == NULL) check_java_exception();
+  do {
+    n = (*env)->CallStaticIntMethod(env, cls, drain, jbuf);
+    if ((*env)->ExceptionCheck(env)) break;
+    (*env)->GetLongArrayRegion(env, jbuf, 0, n, buf);
+    Lock_slots();
+    for (i = 0; i < n; i++) {
+      if ((buf[i] & 1) == 0)
+        release_wrapper(buf[i] >> 1);
+      else if (buf[i] & 2)
+        invalidate_bound(Bound_val(buf[i] >> 2));
+      else {
+        invalidate_bound(Bound_val(buf[i] >> 2));
+        free(Bound_val(buf[i] >> 2));
+      }
+    }
+    Unlock_slots();
+  } while (n == RELEASE_BATCH);
+  (*env)->DeleteLocalRef(env, jbuf);
+  (*env)->DeleteLocalRef(env, cls);
+  check_java_exception();
+}
+
+value camljava_ReleaseCallbacks(value unit)
+{
+  release_callbacks();
+  return Val_unit;
+}
+
 value camljava_WrapCamlObject(value vobj)
 {
-  value * wrapper = caml_stat_alloc(sizeof(value));
-  *wrapper = vobj;
-  caml_register_generational_global_root(wrapper);
-  return caml_copy_int64((jlong) (value) wrapper);
+  if (callbacks_released) release_callbacks();
+  return caml_copy_int64(alloc_slot(vobj));
 }
 
-void camljava_FreeWrapper(JNIEnv * env, jclass cls, jlong wrapper)
+jlong camljava_BindMethod(JNIEnv * env, jclass cls,
+                          jlong wrapper, jlong method_id)
 {
-  value * w = (value *) (value) wrapper;
-  caml_remove_generational_global_root(w);
-  caml_stat_free(w);
+  struct camljava_bound * b;
+  int blocking;
+  value clos;
+  intnat s;
+
+  camljava_check_caml_thread(env);
+  blocking = callback_enter();
+  clos = caml_get_public_method(Slot(wrapper), (value) method_id);
+  b = malloc(sizeof(struct camljava_bound));
+  if (clos == 0 || b == NULL) {
+    free(b);
+    (*env)->ThrowNew(env,
+                     (*env)->FindClass(env,
+                                       clos == 0
+                                       ? "java/lang/IllegalArgumentException"
+                                       : "java/lang/OutOfMemoryError"),
+                     "Callback.bind");
+    callback_leave(blocking);
+    return 0;
+  }
+  s = alloc_slot(clos);
+  Lock_slots();
+  b->closure = s;
+  b->wrapper = wrapper;
+  b->next = Slot_bounds(wrapper);
+  Slot_bounds(wrapper) = b;
+  Unlock_slots();
+  callback_leave(blocking);
+  return (jlong) (value) b;
 }
 
 jlong camljava_GetCamlMethodID(JNIEnv * env, jclass cls, jstring jname)
@@ -955,6 +3613,22 @@ jlong camljava_GetCamlMethodID(JNIEnv * env, jclass cls, jstring jname)
 
 /***************** Registration of native methods with the JNI ************/
 
+#define TYPEDNATIVE(name,n,K,args,jret)                                     \
+  { "callback" #name #n, "(JJ" args ")" jret,                               \
+    (void*)camljava_Callback##name##n##K },
+
+#define TYPEDNATIVESKIND(name,jret,K)                                       \
+  TYPEDNATIVE(name,1,K,Cb_sig_##K,jret)                                     \
+  TYPEDNATIVE(name,2,K,Cb_sig_##K Cb_sig_##K,jret)                          \
+  TYPEDNATIVE(name,3,K,Cb_sig_##K Cb_sig_##K Cb_sig_##K,jret)
+
+#define TYPEDNATIVES(name,jret)                                             \
+  TYPEDNATIVE(name,0,,"",jret)                                              \
+  TYPEDNATIVESKIND(name,jret,O)                                             \
+  TYPEDNATIVESKIND(name,jret,I)                                             \
+  TYPEDNATIVESKIND(name,jret,J)                                             \
+  TYPEDNATIVESKIND(name,jret,D)
+
 static JNINativeMethod camljava_natives[] =
 { { "callbackVoid", "(JJ[Ljava/lang/Object;)V", (void*)camljava_CallbackVoid },
   { "callbackBoolean", "(JJ[Ljava/lang/Object;)Z", (void*)camljava_CallbackBoolean },
@@ -968,15 +3642,35 @@ static JNINativeMethod camljava_natives[] =
   { "callbackDouble", "(JJ[Ljava/lang/Object;)D", (void*)camljava_CallbackDouble },
   { "callbackObject", "(JJ[Ljava/lang/Object;)Ljava/lang/Object;",
     (void*)camljava_CallbackObject },
-  { "freeWrapper", "(J)V", (void*)camljava_FreeWrapper },
-  { "getCamlMethodID", "(Ljava/lang/String;)J", (void*)camljava_GetCamlMethodID }
+  { "getCamlMethodID", "(Ljava/lang/String;)J", (void*)camljava_GetCamlMethodID },
+  { "bindMethod", "(JJ)J", (void*)camljava_BindMethod },
+  { "notifyReleased", "()V", (void*)camljava_NotifyReleased },
+  TYPEDNATIVES(Void, "V")
+  TYPEDNATIVES(Boolean, "Z")
+  TYPEDNATIVES(Camlint, "I")
+  TYPEDNATIVES(Int, "I")
+  TYPEDNATIVES(Long, "J")
+  TYPEDNATIVES(Double, "D")
+  TYPEDNATIVES(Object, "Ljava/lang/Object;")
+};
+
+static JNINativeMethod camljava_pressure_natives[] =
+{ { "notifyPressure", "()V", (void*)camljava_NotifyPressure }
 };
 
-value camljava_RegisterNatives(value unit)
+static int register_natives(JNIEnv * env)
 {
-  jclass cls = (*jenv)->FindClass(jenv, "fr/inria/caml/camljava/Callback");
-  if (cls == NULL) check_java_exception();
-  (*jenv)->RegisterNatives(jenv, cls, camljava_natives,
-                           sizeof(camljava_natives) / sizeof(JNINativeMethod));
-  return Val_unit;
+  jclass cls = (*env)->FindClass(env, "fr/inria/caml/camljava/Callback");
+  if (cls == NULL) return -1;
+  if ((*env)->RegisterNatives(env, cls, camljava_natives,
+                              sizeof(camljava_natives)
+                              / sizeof(JNINativeMethod)) != 0)
+    return -1;
+  cls = (*env)->FindClass(env, "fr/inria/caml/camljava/MemoryPressure");
+  if (cls == NULL) return -1;
+  if ((*env)->RegisterNatives(env, cls, camljava_pressure_natives,
+                              sizeof(camljava_pressure_natives)
+                              / sizeof(JNINativeMethod)) != 0)
+    return -1;
+  return 0;
 }
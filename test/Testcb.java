@@ -1,3 +1,4 @@
+import fr.inria.caml.camljava.BoundCallback;
 import fr.inria.caml.camljava.Callback;
 
 class Testcb {
@@ -10,4 +11,13 @@ class Testcb {
     public int g(int x)
     { Object[] args = { new fr.inria.caml.camljava.Camlint(x) };
       return cb.callCamlint(_g, args); }
+    public int g1(int x)
+    { return cb.callCamlint1(_g, x); }
+    // Through a bound callback, which must refuse calls once released
+    public int g2(int x)
+    { BoundCallback b = cb.bind(_g);
+      int r = b.callCamlint1(x);
+      b.release();
+      try { b.callCamlint1(x); } catch (IllegalStateException e) { return r; }
+      return -1; }
 }
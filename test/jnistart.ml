@@ -0,0 +1,27 @@
+(* The first Jni operation starts the JVM.  Run with a small minor heap
+   (OCAMLRUNPARAM=s=4k): the string argument of that first operation is
+   freshly allocated, and must not move while the JVM starts. *)
+
+open Jni
+
+let fresh s = String.concat "" [s; ""]
+
+let _ =
+  match Sys.argv with
+  | [| _; "string_to_java" |] ->
+      let s = string_to_java (fresh "camljava") in
+      print_string "string_to_java: "; print_string (string_from_java s);
+      print_newline()
+  | _ ->
+      let c = find_class (fresh "java/lang/String") in
+      (* [c] is not an [obj]: get its name through an instance *)
+      let o = alloc_object c in
+      let k = call_object_method o
+                (get_methodID (find_class "java/lang/Object")
+                   "getClass" "()Ljava/lang/Class;") [||] in
+      print_string "find_class: ";
+      print_string (string_from_java
+                      (call_object_method k
+                         (get_methodID (find_class "java/lang/Class")
+                            "getName" "()Ljava/lang/String;") [||]));
+      print_newline()
@@ -65,6 +65,173 @@ let test() =
   print_string "Calling Test.k(<caml object>, 2)"; print_newline();
   let r = call_static_int_method c k [|Obj cb; Camlint 2|] in
   print_string "Result is: "; print_string (Int32.to_string r); 
+  print_newline();
+  print_string "Calling <caml object>.g1(5) through a typed callback";
+  print_newline();
+  let g1 = get_methodID (find_class "Testcb") "g1" "(I)I" in
+  print_string "Result is: "; print_int (call_camlint_method_1_int cb g1 5);
+  print_newline();
+  print_string "Calling <caml object>.g2(6) through a released bound callback";
+  print_newline();
+  let g2 = get_methodID (find_class "Testcb") "g2" "(I)I" in
+  print_string "Result is: "; print_int (call_camlint_method_1_int cb g2 6);
+  print_newline();
+  release_callbacks();
+  (* Callback root slots *)
+  print_string "Wrapping 2000 more Caml objects"; print_newline();
+  let before = (Stats.snapshot()).Stats.live_callback_roots in
+  let cbs = Array.init 2000 (fun _ -> wrap_caml_object()) in
+  let after = (Stats.snapshot()).Stats.live_callback_roots in
+  print_string "Roots taken: "; print_string (string_of_bool (after - before >= 2000));
+  release_callbacks();
+  let r = call_static_int_method c k [|Obj cbs.(1999); Camlint 3|] in
+  print_string ", last callback result: "; print_string (Int32.to_string r);
+  print_newline();
+  (* Fixed-arity method invocation *)
+  print_string "Calling testinstance.h() without argument array"; print_newline();
+  let r = call_camlint_method_0 o h in
+  print_string "Result is: "; print_int r; print_newline();
+  (* Bulk array transfers *)
+  print_string "Converting [|1.5; 2.5; 3.5|] to double[] and back"; print_newline();
+  let a = double_array_from_java (double_array_to_java [|1.5; 2.5; 3.5|]) in
+  print_string "Result is:";
+  Array.iter (fun x -> print_string " "; print_float x) a;
+  print_newline();
+  print_string "Converting [|1; -2; 3|] to long[] and back"; print_newline();
+  let a = long_array_from_java (long_array_to_java [|1; -2; 3|]) in
+  print_string "Result is:";
+  Array.iter (fun x -> print_string " "; print_int x) a;
+  print_newline();
+  (* Local frames *)
+  print_string "Using a local reference after its frame";
+  print_newline();
+  let s = with_local_frame 4 (fun () -> string_to_java "local") in
+  print_string "Result is: ";
+  print_string (try string_from_java s with Invalid_argument _ -> "refused");
+  print_newline();
+  (* Critical access *)
+  print_string "Summing an int[] in a critical section"; print_newline();
+  let ia = camlint_array_to_java [|10; 20; 30|] in
+  let sum =
+    with_critical_int_array ia (fun ba ->
+      let s = ref 0 in
+      for i = 0 to Bigarray.Array1.dim ba - 1 do
+        s := !s + Int32.to_int (Bigarray.Array1.unsafe_get ba i)
+      done;
+      !s) in
+  print_string "Sum: "; print_int sum;
+  let cs = find_class "java/lang/String" in
+  let failed =
+    with_critical_int_array ia (fun _ ->
+      try ignore (is_instance_of ia cs); false with Failure _ -> true) in
+  print_string ", JNI call refused inside: "; print_string (string_of_bool failed);
+  print_newline();
+  (* UTF-8 <-> UTF-16 *)
+  print_string "Converting a supplementary character and an embedded NUL";
+  print_newline();
+  let length = get_methodID cs "length" "()I" in
+  List.iter
+    (fun str ->
+      let js = string_to_java str in
+      print_string "Java length: "; print_int (call_camlint_method_0 js length);
+      print_string ", round trip: ";
+      print_string (string_of_bool (string_from_java js = str));
+      print_newline())
+    ["\xF0\x9F\x98\x80"; "a\000b"];
+  print_string "Converting [|\"foo\"; null_string; \"bar\"|] to String[] and back";
+  print_newline();
+  let a =
+    strings_of_java_array (java_array_of_strings [|"foo"; null_string; "bar"|]) in
+  print_string "Result is:";
+  Array.iter (fun s -> print_string " ";
+                       print_string (if is_null_string s then "null" else s)) a;
+  print_newline();
+  (* Batched invocation *)
+  print_string "Calling h() on testinstance, null and another instance";
+  print_newline();
+  let o2 = alloc_object c in
+  call_nonvirtual_void_method o2 c init [||];
+  set_int_field o2 b (Int32.of_int 7);
+  let res = Array.make 3 0 in
+  let failed = batch_call_camlint_method h [|o; null; o2|] [||] res in
+  print_string "Results:";
+  Array.iter (fun r -> print_string " "; print_int r) res;
+  print_string ", failed:";
+  List.iter (fun (i, e) -> print_string " "; print_int i;
+                           if is_null e then print_string " (null)") failed;
+  print_newline();
+  (* Exception mapping *)
+  print_string "Calling Integer.parseInt(\"foo\")"; print_newline();
+  set_exception_mapping true;
+  let ci = find_class "java/lang/Integer" in
+  let parse = get_static_methodID ci "parseInt" "(Ljava/lang/String;)I" in
+  begin try
+    ignore (call_static_camlint_method ci parse [|Obj (string_to_java "foo")|]);
+    print_string "No exception!"
+  with Number_format_exception e ->
+    print_string "Exception: "; print_string (exception_class_name e);
+    print_string ": "; print_string (exception_message e)
+  end;
+  print_newline();
+  set_exception_mapping false;
+  (* Statistics *)
+  print_string "Counting calls to testinstance.h()"; print_newline();
+  Stats.reset(); Stats.enable true;
+  ignore (call_camlint_method_0 o h);
+  ignore (call_int_method o h [||]);
+  Stats.enable false;
+  let st = Stats.snapshot() in
+  print_string "Virtual calls: "; print_int st.Stats.virtual_calls;
+  print_newline();
+  (* Identity hashing *)
+  print_string "Hashing two references to testinstance"; print_newline();
+  let arr = new_object_array 1 c in
+  set_object_array_element arr 0 o;
+  let c1 = o and c2 = get_object_array_element arr 0 in
+  let tbl = ObjTbl.create 7 in
+  ObjTbl.replace tbl c1 "class";
+  let wtbl = WeakObjTbl.create 7 in
+  WeakObjTbl.replace wtbl c1 "class";
+  print_string "Same hash: ";
+  print_string (string_of_bool (Hashtbl.hash c1 = Hashtbl.hash c2));
+  print_string ", equal: "; print_string (string_of_bool (c1 = c2));
+  print_string ", found: "; print_string (ObjTbl.find tbl c2);
+  print_string ", weakly: "; print_string (WeakObjTbl.find wtbl c2);
+  print_newline();
+  (* Direct buffers *)
+  print_string "Writing a direct ByteBuffer through a sub-array of its view";
+  print_newline();
+  let cb = find_class "java/nio/ByteBuffer" in
+  let buf =
+    call_static_object_method cb
+      (get_static_methodID cb "allocateDirect" "(I)Ljava/nio/ByteBuffer;")
+      [|Camlint 16|] in
+  let sub =
+    Bigarray.Array1.sub (Direct.of_byte_buffer Bigarray.char buf) 8 8 in
+  Gc.full_major(); Direct.sweep();
+  sub.{0} <- 'x';
+  print_string "Byte 8: ";
+  print_int (call_byte_method buf (get_methodID cb "get" "(I)B") [|Camlint 8|]);
+  print_newline();
+  (* Collections *)
+  print_string "Round trip of [1..1000] through an ArrayList";
+  print_newline();
+  let l = Collections.of_camlint_array (Array.init 1000 (fun i -> i + 1)) in
+  let sum = Seq.fold_left (+) 0 (Collections.camlint_seq ~chunk:64 l) in
+  print_string "Sum: "; print_int sum;
+  print_string ", elements: ";
+  print_int (Array.length (Collections.to_array l));
+  let m = Collections.map_of_bindings [|(l, o)|] in
+  print_string ", binding found: ";
+  print_string
+    (string_of_bool (match Collections.bindings m with
+                     | [|(k, v)|] -> is_same_object k l && is_same_object v o
+                     | _ -> false));
+  let m =
+    Collections.map_of_bindings ~chunk:3
+      (Array.init 7 (fun i -> (string_to_java (string_of_int i), o))) in
+  print_string ", bindings put in chunks of 3: ";
+  print_int (Array.length (Collections.bindings m));
   print_newline()
 
 let _ =